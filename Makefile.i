@@ -32,7 +32,8 @@ clean:
 
 define make-goal
 objs/$1/%.o: %.cc
-	$(CC) $(CCFLAGS_$(1)) -c $$< -o $$@
+	@mkdir -p $$(@D)
+	$(CC) $(CCFLAGS_$(1)) $$($$*_CCFLAGS) -c $$< -o $$@
 endef
 
 define make-build-dir
@@ -47,7 +48,7 @@ $(foreach bdir,$(BUILD_DIRS),$(eval $(call make-goal,$(bdir))))
 
 define make-bin
 -include $$(patsubst %.cc,objs/$1/%.d,$($(2)_SRCS))
-exec/$1/$2: $$(patsubst %.cc,objs/$1/%.o,$($(2)_SRCS)) $($2_BINDEPS)
+exec/$1/$2: $$(patsubst %.cc,objs/$1/%.o,$($(2)_SRCS)) $($2_BINDEPS) $(foreach lib,$($2_DEPLIBS),lib/$1/lib$(lib).a)
 	$(CC) $$^ $(LDFLAGS_$1) $($2_LIBS) $(SYS_LIBS) -o $$@
 endef
 
@@ -0,0 +1,158 @@
+//
+// huge page backed allocation for the aligned vectors (see aligned.h)
+//
+
+#include "aligned.h"
+
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+page_mode selected_page_mode()
+{
+  static const page_mode mode = []() {
+    const char *p = getenv("SPEEDSTUMPS_PAGES");
+    if(!p) {
+      return page_mode::normal;
+    } else if(strcmp(p, "thp") == 0) {
+      return page_mode::transparent;
+    } else if(strcmp(p, "2mb") == 0) {
+      return page_mode::hugetlb_2mb;
+    } else if(strcmp(p, "1gb") == 0) {
+      return page_mode::hugetlb_1gb;
+    }
+    return page_mode::normal;
+  }();
+  return mode;
+}
+
+const char *page_mode_name(page_mode mode_)
+{
+  switch(mode_) {
+  case page_mode::normal:
+    return "normal";
+  case page_mode::transparent:
+    return "thp";
+  case page_mode::hugetlb_2mb:
+    return "2mb";
+  case page_mode::hugetlb_1gb:
+    return "1gb";
+  }
+  return "unknown";
+}
+
+// every mapping we handed out, keyed by the pointer the caller got: a hugetlb mapping has to be unmapped in
+// whole pages so we can't rederive it from the block size (allocations are rare, this is only touched when
+// a forest is built) (function statics, since aligned vectors can be allocated during static initialization)
+struct mapping {
+  void *base;
+  size_t length;
+};
+
+struct mapping_table {
+  std::mutex lock;
+  std::map<void *, mapping> blocks;
+  size_t colour = 0;
+};
+
+static mapping_table &mappings()
+{
+  static mapping_table t;
+  return t;
+}
+
+static size_t round_up(size_t n_, size_t to_)
+{
+  return (n_ + to_ - 1) & ~(to_ - 1);
+}
+
+static void *map_hugetlb(size_t bytes_, size_t page_, int flag_, size_t &len_)
+{
+  size_t len = len_ = round_up(bytes_, page_);
+  void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | flag_, -1, 0);
+  if(p == MAP_FAILED) {
+    return nullptr;
+  }
+  return p;
+}
+
+// a 2MB aligned anonymous mapping, trimmed from a slightly bigger one, marked for transparent huge pages
+static void *map_transparent(size_t bytes_, size_t &len_)
+{
+  const size_t HUGE = 2 << 20;
+  size_t len = len_ = round_up(bytes_, HUGE);
+  char *raw = (char *)mmap(nullptr, len + HUGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(raw == MAP_FAILED) {
+    return nullptr;
+  }
+  char *p = (char *)round_up((uintptr_t)raw, HUGE);
+  if(p != raw) {
+    munmap(raw, p - raw);
+  }
+  if(p + len != raw + len + HUGE) {
+    munmap(p + len, raw + len + HUGE - (p + len));
+  }
+  madvise(p, len, MADV_HUGEPAGE);
+  return p;
+}
+
+// the mappings all start on a 2MB boundary, so the parallel arrays of a forest (the soa layout streams ten
+// of them at once) would all map to the same cache sets; each block starts a few lines further in than
+// the last to spread them out
+const size_t COLOURS = 32;
+
+void *allocate_aligned(size_t bytes_, size_t align_)
+{
+  page_mode mode = selected_page_mode();
+  if(bytes_ >= HUGE_PAGE_MIN && mode != page_mode::normal) {
+    mapping_table &t = mappings();
+    std::lock_guard<std::mutex> lock(t.lock);
+    size_t offset = (t.colour++ % COLOURS) * (align_ < 64 ? 64 : align_);
+    size_t len = 0;
+    void *p = nullptr;
+    if(mode == page_mode::hugetlb_1gb) {
+      p = map_hugetlb(bytes_ + offset, 1 << 30, MAP_HUGE_1GB, len);
+    }
+    if(!p && (mode == page_mode::hugetlb_1gb || mode == page_mode::hugetlb_2mb)) {
+      p = map_hugetlb(bytes_ + offset, 2 << 20, MAP_HUGE_2MB, len);
+    }
+    if(!p) {
+      p = map_transparent(bytes_ + offset, len);
+    }
+    if(p) {
+      void *q = (char *)p + offset;
+      t.blocks[q] = {p, len};
+      return q;
+    }
+  }
+  return ::operator new(bytes_, std::align_val_t(align_));
+}
+
+void deallocate_aligned(void *p_, size_t bytes_, size_t align_)
+{
+  if(bytes_ >= HUGE_PAGE_MIN) {
+    mapping_table &t = mappings();
+    std::lock_guard<std::mutex> lock(t.lock);
+    auto m = t.blocks.find(p_);
+    if(m != t.blocks.end()) {
+      munmap(m->second.base, m->second.length);
+      t.blocks.erase(m);
+      return;
+    }
+  }
+  ::operator delete(p_, std::align_val_t(align_));
+}
@@ -0,0 +1,57 @@
+//
+// aligned storage for simd arrays
+//
+// the big blocks (HUGE_PAGE_MIN bytes or more, ie the arrays of a large forest rather than scratch) can be
+// mmap'd on a 2MB boundary and backed by huge pages: a 500k tree forest is tens of MB, which with 4KB pages
+// means thousands of dTLB entries for one pass over it.  SPEEDSTUMPS_PAGES picks how:
+//
+// normal  : plain operator new, no huge pages (the default, the kernels stream their arrays in order so the
+//           page walks mostly overlap with the loads; measure before turning it on)
+// thp     : transparent huge pages via madvise(MADV_HUGEPAGE)
+// 2mb/1gb : explicit hugetlbfs pages (MAP_HUGETLB), which have to be reserved by the admin first, falling
+//           back to thp when there are none
+//
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+enum class page_mode { normal, transparent, hugetlb_2mb, hugetlb_1gb };
+
+// blocks smaller than this always come from operator new (a block of half a huge page or more is rounded
+// up to whole pages, the padding is cheaper than the tlb misses)
+const size_t HUGE_PAGE_MIN = 1 << 20;
+
+// from SPEEDSTUMPS_PAGES, decided once
+page_mode selected_page_mode();
+const char *page_mode_name(page_mode mode_);
+
+// bytes_ with alignment align_ (a power of two <= 4096), huge page backed as above when big enough
+void *allocate_aligned(size_t bytes_, size_t align_);
+void deallocate_aligned(void *p_, size_t bytes_, size_t align_);
+
+// std allocator handing out ALIGN-byte aligned blocks (64 = one cache line, enough for any simd width we use)
+template<typename T, size_t ALIGN = 64>
+struct aligned_allocator {
+  typedef T value_type;
+
+  template<typename U> struct rebind { typedef aligned_allocator<U, ALIGN> other; };
+
+  aligned_allocator() = default;
+  template<typename U> aligned_allocator(const aligned_allocator<U, ALIGN> &) {}
+
+  T *allocate(size_t n_) {
+    return static_cast<T *>(allocate_aligned(n_ * sizeof(T), ALIGN));
+  }
+  void deallocate(T *p_, size_t n_) {
+    deallocate_aligned(p_, n_ * sizeof(T), ALIGN);
+  }
+
+  template<typename U> bool operator==(const aligned_allocator<U, ALIGN> &) const { return true; }
+  template<typename U> bool operator!=(const aligned_allocator<U, ALIGN> &) const { return false; }
+};
+
+template<typename T>
+using aligned_vector = std::vector<T, aligned_allocator<T>>;
@@ -0,0 +1,81 @@
+//
+// weighted / anytime scoring (see anytime.h)
+//
+
+#include "anytime.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+#include "reorder.h"
+
+anytime_forest::anytime_forest(const forest2 &f_, const std::vector<float> &weights_, double bias_)
+  : bias(bias_)
+{
+  if(!weights_.empty() && weights_.size() != f_.size()) {
+    throw std::invalid_argument("one weight per tree");
+  }
+
+  forest2 weighted = f_;
+  std::vector<double> reach(f_.size());
+  for(size_t i = 0 ; i < f_.size() ; ++i) {
+    tree2 &t = weighted[i];
+    if(!weights_.empty()) {
+      t.one *= weights_[i];
+      t.two *= weights_[i];
+      t.three *= weights_[i];
+      t.four *= weights_[i];
+    }
+    reach[i] = std::max({std::abs(t.one), std::abs(t.two), std::abs(t.three), std::abs(t.four)});
+  }
+
+  std::vector<size_t> order(f_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t l_, size_t r_) { return reach[l_] > reach[r_]; });
+
+  size_t chunks = (f_.size() + ANYTIME_CHUNK - 1) / ANYTIME_CHUNK;
+  bound.assign(chunks + 1, 0.0);
+  for(size_t c = 0 ; c < chunks ; ++c) {
+    forest2 chunk;
+    for(size_t i = c * ANYTIME_CHUNK ; i < std::min(f_.size(), (c + 1) * ANYTIME_CHUNK) ; ++i) {
+      chunk.push_back(weighted[order[i]]);
+      bound[c] += reach[order[i]];
+    }
+    for(const auto &t : reorder_forest2(chunk)) {
+      trees.push_back(t);
+    }
+  }
+  for(size_t c = chunks ; c-- > 0 ; ) {
+    bound[c] += bound[c + 1];
+  }
+}
+
+anytime_result rf_score_anytime(const anytime_forest &f_, const float *x_, const anytime_budget &budget_)
+{
+  forest2_soa_view all = f_.trees.view();
+  anytime_result r = {f_.bias, 0, false};
+
+  for(size_t c = 0 ; c < f_.chunks() ; ++c) {
+    // the chunk as a view of its own
+    size_t i = c * ANYTIME_CHUNK, n = std::min(ANYTIME_CHUNK, all.padded_size - i);
+    forest2_soa_view v = { all.a_splitVarID + i, all.c_splitVarID + i, all.e_splitVarID + i,
+			   all.b_splitValue + i, all.d_splitValue + i, all.f_splitValue + i,
+			   all.one + i, all.two + i, all.three + i, all.four + i,
+			   std::min(n, all.size - i), n };
+    r.margin += rf_sum_soa(v, x_);
+    r.trees += v.size;
+
+    if(budget_.threshold && std::abs(r.margin - *budget_.threshold) > f_.bound[c + 1]) {
+      r.decided = true;
+      return r;
+    }
+    if(r.trees >= budget_.max_trees || (budget_.deadline && std::chrono::steady_clock::now() >= *budget_.deadline)) {
+      break;
+    }
+  }
+
+  r.decided = r.trees == all.size;
+  return r;
+}
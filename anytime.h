@@ -0,0 +1,61 @@
+//
+// weighted and anytime (early exit) scoring of depth-2 forests
+//
+// boosted models sum weighted trees plus a bias instead of averaging them, and a latency bound caller
+// may not want to wait for all of them.  anytime_forest keeps a forest2_soa with the weights folded into
+// the leaves, in decreasing order of how much each tree can move the result (|weight| * largest |leaf|),
+// and scores it a chunk of ANYTIME_CHUNK trees at a time with rf_sum_soa.  between chunks it can stop on:
+//
+// - a tree budget (rounded up to a whole chunk)
+// - a deadline
+// - a decision threshold: once |margin - threshold| is more than the most the remaining trees could add,
+//   the side of the threshold can't change any more, so the answer is the same as a full evaluation's
+//
+// within a chunk the trees are sorted by split feature (see reorder.h) since only the chunk boundaries are
+// stopping points, and the chunks are consecutive in memory so an early exit has streamed a prefix of the
+// model, which suits the hardware prefetcher
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "forest.h"
+#include "forest_soa.h"
+
+// trees between stopping points (a multiple of 8)
+const size_t ANYTIME_CHUNK = 512;
+
+struct anytime_forest {
+  forest2_soa trees;          // importance order, weights folded in
+  std::vector<double> bound;  // bound[c] = the most chunks c onwards can add to |margin|, bound[chunks] = 0
+  double bias = 0.0;
+
+  // weights_ is one per tree (empty for all 1)
+  anytime_forest(const forest2 &f_, const std::vector<float> &weights_ = {}, double bias_ = 0.0);
+
+  size_t chunks() const { return bound.size() - 1; }
+};
+
+struct anytime_budget {
+  size_t max_trees = SIZE_MAX;
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+  std::optional<double> threshold;
+};
+
+struct anytime_result {
+  double margin;     // bias + weighted sum over the trees scored
+  size_t trees;      // trees scored
+  bool decided;      // margin is on the same side of the threshold as the full sum would be (true when all trees were scored)
+};
+
+anytime_result rf_score_anytime(const anytime_forest &f_, const float *x_, const anytime_budget &budget_ = {});
+
+// bias + weighted sum over every tree
+inline double rf_sum_weighted(const anytime_forest &f_, const float *x_)
+{
+  return rf_score_anytime(f_, x_).margin;
+}
@@ -0,0 +1,320 @@
+//
+// the benchmark suite: every kernel over a sweep of forest sizes (from l1 resident to well past the last
+// level cache), batch sizes and thread counts (see bench.h for how calls are timed)
+//
+// usage: bench [--quick] [filter]
+//        bench --check [rounds [seed]]
+//
+// --quick stops at 256k trees and spends less time per measurement, a filter only runs the kernels whose
+// name contains it.  one line per measurement:
+//
+// kernel, trees, rows and threads per call, the median and p99 time per call, trees/s (trees x rows scored
+// per second) and GB/s (bytes of model the call reads, per second: once per row for the per-row kernels,
+// once per call for the tiled batches)
+//
+// where the hardware counters are available (see perf.h) each line also gets instructions per cycle, llc
+// and dtlb misses per 1000 trees x rows and the memory traffic those llc misses imply, from a second,
+// untimed round of calls.  they only count the calling thread, so for the threaded kernels they cover the
+// caller's share of the work
+//
+// --check runs the equivalence checks of check.h instead (default 200 rounds from seed 1) and exits
+// nonzero if any comparison failed
+//
+
+#include <sched.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "check.h"
+#include "conditions.h"
+#include "cpu.h"
+#include "flat_forest.h"
+#include "forest.h"
+#include "forest_soa.h"
+#include "gpu.h"
+#include "half.h"
+#include "numa.h"
+#include "parallel.h"
+#include "perf.h"
+#include "pool.h"
+#include "quantize.h"
+#include "quickscorer.h"
+#include "stumps.h"
+
+const size_t NUM_PREDS = 256;
+
+struct bench_config {
+  std::vector<size_t> sizes;
+  std::vector<size_t> rows;
+  int64_t budget;              // nanoseconds per measurement
+  std::string filter;
+};
+
+static bench_config config;
+static perf_counters *counters;
+
+static void header()
+{
+  std::cout << std::left << std::setw(34) << "kernel" << std::right << std::setw(9) << "trees" << std::setw(6) << "rows"
+	    << std::setw(8) << "threads" << std::setw(14) << "median ns" << std::setw(14) << "p99 ns"
+	    << std::setw(12) << "Mtrees/s" << std::setw(9) << "GB/s";
+  if(counters->hardware()) {
+    std::cout << std::setw(7) << "IPC" << std::setw(11) << "llc/ktree" << std::setw(12) << "dtlb/ktree"
+	      << std::setw(10) << "llc GB/s";
+  }
+  std::cout << std::endl;
+}
+
+// whether the filter lets name_ run, for kernels whose setup is too costly to do for nothing
+static bool selected(const std::string &name_)
+{
+  return name_.find(config.filter) != std::string::npos;
+}
+
+// the line for a kernel the forest can't be prepared for
+static void skipped(const std::string &name_, size_t trees_, const std::exception &e_)
+{
+  std::cout << std::left << std::setw(34) << name_ << std::right << std::setw(9) << trees_ << "  skipped: "
+	    << e_.what() << std::endl;
+}
+
+// time f_ and print its line, bytes_ is what one call reads
+template<typename FUNC>
+static void run(const std::string &name_, size_t trees_, size_t rows_, size_t threads_, double bytes_, FUNC f_)
+{
+  if(!selected(name_)) {
+    return;
+  }
+  bench_stats s = measure_for(f_, config.budget, 3);
+  std::cout << std::left << std::setw(34) << name_ << std::right << std::setw(9) << trees_ << std::setw(6) << rows_
+	    << std::setw(8) << threads_ << std::setw(14) << (uint64_t)s.median << std::setw(14) << (uint64_t)s.p99
+	    << std::fixed << std::setprecision(1) << std::setw(12) << trees_ * rows_ / s.median * 1e3
+	    << std::setprecision(2) << std::setw(9) << bytes_ / s.median;
+
+  if(counters->hardware()) {
+    const size_t reps = std::min<size_t>(s.trials, 100);
+    perf_sample before = counters->read();
+    for(size_t i = 0 ; i < reps ; ++i) {
+      keep(f_());
+    }
+    perf_sample c = counters->read() - before;
+    auto per_ktree = [&](perf_event_id e_) { return c[e_] * 1000.0 / ((double)reps * trees_ * rows_); };
+    std::cout << std::setw(7) << c.ipc() << std::setw(11) << per_ktree(PERF_LLC_MISSES)
+	      << std::setw(12) << per_ktree(PERF_DTLB_MISSES)
+	      << std::setw(10) << (double)c.bytes() / c[PERF_TASK_CLOCK];
+  }
+  std::cout << std::defaultfloat << std::endl;
+}
+
+// the same depth-2 tree as a node list, in the order compile_forest2 expects
+static tree unpack_tree2(const tree2 &t_)
+{
+  return { { 1, 2, t_.a_splitVarID, t_.b_splitValue }, { 3, 4, t_.c_splitVarID, t_.d_splitValue },
+	   { 5, 6, t_.e_splitVarID, t_.f_splitValue }, { 0, 0, 0, t_.one }, { 0, 0, 0, t_.two },
+	   { 0, 0, 0, t_.three }, { 0, 0, 0, t_.four } };
+}
+
+static void bench_stumps(size_t n_, const std::vector<float> &x_)
+{
+  std::mt19937_64 g(n_);
+  std::uniform_real_distribution<float> d(-0.1, 0.1);
+  stump_forest f;
+  for(size_t i = 0 ; i < n_ ; ++i) {
+    f.push_back(g() % NUM_PREDS, d(g), d(g), d(g));
+  }
+  stump_forest_half h(f, half_format::fp16);
+
+  // selectf works on values already gathered per stump
+  aligned_vector<float> a(n_);
+  for(size_t i = 0 ; i < n_ ; ++i) {
+    a[i] = x_[f.splitVarID[i]];
+  }
+  run("selectf", n_, 1, 1, 16.0 * n_, [&]() { return selectf(&a[0], &f.splitValue[0], &f.left[0], &f.right[0], n_); });
+  run("rf_eval_stumps", n_, 1, 1, 16.0 * n_, [&]() { return rf_eval_stumps(f, &x_[0]); });
+  run("rf_eval_stumps_half fp16", n_, 1, 1, 10.0 * n_, [&]() { return rf_eval_stumps_half(h, &x_[0]); });
+
+  // b, x and y are read once per call, a once per row
+  for(size_t rows : config.rows) {
+    if(rows == 1 || rows * n_ > (1 << 24)) {
+      continue;
+    }
+    aligned_vector<float> batch(rows * n_);
+    for(size_t r = 0 ; r < rows ; ++r) {
+      std::copy(a.begin(), a.end(), batch.begin() + r * n_);
+    }
+    std::vector<float> out(rows);
+    run("selectf_batch", n_, rows, 1, 12.0 * n_ + 4.0 * n_ * rows, [&]() {
+      selectf_batch(&batch[0], n_, &f.splitValue[0], &f.left[0], &f.right[0], n_, rows, &out[0]);
+      return out[0];
+    });
+    // every row the same sample, scored against the stumps themselves rather than pre-gathered values
+    std::vector<float> xs(rows * NUM_PREDS);
+    for(size_t r = 0 ; r < rows ; ++r) {
+      std::copy(x_.begin(), x_.begin() + NUM_PREDS, xs.begin() + r * NUM_PREDS);
+    }
+    std::vector<double> sums(rows);
+    run("rf_eval_stumps_batch", n_, rows, 1, 16.0 * n_, [&]() {
+      rf_eval_stumps_batch(f, &xs[0], rows, NUM_PREDS, &sums[0]);
+      return sums[0];
+    });
+  }
+}
+
+static void bench_forest2(size_t n_, const std::vector<float> &x_, const std::vector<float> &batch_)
+{
+  std::mt19937_64 g(n_);
+  std::uniform_real_distribution<float> d(-0.1, 0.1);
+  forest2 f2(n_);
+  for(auto &t : f2) {
+    t = { (uint32_t)(g() % NUM_PREDS), (uint32_t)(g() % NUM_PREDS), (uint32_t)(g() % NUM_PREDS),
+	  d(g), d(g), d(g), d(g), d(g), d(g), d(g) };
+  }
+  forest2_soa soa(f2);
+
+  run("rf_eval_simd", n_, 1, 1, 40.0 * n_, [&]() { return rf_eval_simd(f2, x_); });
+  run("rf_eval_simd_gather", n_, 1, 1, 40.0 * n_, [&]() { return rf_eval_simd_gather(f2, x_); });
+  run("rf_eval_soa", n_, 1, 1, 40.0 * n_, [&]() { return rf_eval_soa(soa, x_); });
+  {
+    forest2_soa_half h(soa, half_format::fp16);
+    run("rf_eval_soa_half fp16", n_, 1, 1, 26.0 * n_, [&]() { return rf_eval_soa_half(h, &x_[0]); });
+  }
+  // random float thresholds give a big forest more distinct splits per predictor than these can bin
+  if(selected("rf_eval_quantized (+ binning)")) {
+    try {
+      feature_bins bins(soa, NUM_PREDS);
+      quantized_soa q(soa, bins);
+      std::vector<int16_t> qx(NUM_PREDS + 1);
+      run("rf_eval_quantized (+ binning)", n_, 1, 1, 28.0 * n_, [&]() {
+	bins.quantize(&x_[0], &qx[0]);
+	return rf_eval_quantized(q, &qx[0]);
+      });
+    } catch(const std::invalid_argument &e) {
+      skipped("rf_eval_quantized (+ binning)", n_, e);
+    }
+  }
+  if(selected("rf_eval_conditions (+ evaluate)")) {
+    condition_forest c(soa, NUM_PREDS);
+    std::vector<uint32_t> bits(c.words());
+    run("rf_eval_conditions (+ evaluate)", n_, 1, 1, 28.0 * n_, [&]() {
+      c.evaluate(&x_[0], &bits[0]);
+      return rf_eval_conditions(c, &bits[0]);
+    });
+  }
+
+  // the node list kernels, only while the forest is small enough that a vector<tree> of it is reasonable
+  if(n_ <= (1 << 18)) {
+    std::vector<tree> f;
+    f.reserve(n_);
+    for(const auto &t : f2) {
+      f.push_back(unpack_tree2(t));
+    }
+    run("rf_eval", n_, 1, 1, 7 * 32.0 * n_, [&]() { return rf_eval(f, x_); });
+    flat_forest flat(f);
+    run("rf_eval_flat", n_, 1, 1, 8 * 16.0 * n_, [&]() { return rf_eval_flat(flat, &x_[0]); });
+    quickscorer_forest qs(f, NUM_PREDS);
+    run("rf_eval_quickscorer", n_, 1, 1, 40.0 * n_, [&]() { return rf_eval_quickscorer(qs, x_); });
+  }
+
+  // batches: the tiled batch reads the forest once per call
+  std::vector<double> out(config.rows.back());
+  for(size_t rows : config.rows) {
+    run("rf_eval_simd_batch", n_, rows, 1, 40.0 * n_, [&]() {
+      rf_eval_simd_batch(f2, &batch_[0], rows, NUM_PREDS, sample_layout::row_major, &out[0]);
+      return out[0];
+    });
+  }
+
+  // the gpu backend (which hands batches below GPU_MIN_WORK, or everything without a device, to the cpu)
+  {
+    gpu_forest2 gpu(soa);
+    for(size_t rows : config.rows) {
+      run(gpu.on_device() ? "rf_eval_gpu_batch" : "rf_eval_gpu_batch (cpu fallback)", n_, rows, 1, 40.0 * n_, [&]() {
+	rf_eval_gpu_batch(gpu, &batch_[0], rows, NUM_PREDS, &out[0]);
+	return out[0];
+      });
+    }
+  }
+
+  // and threads, 1, 2, 4 .. up to every cpu we may use
+  cpu_topology topo = get_topology();
+  cpu_topology others = without_cpu(topo, sched_getcpu());
+  for(size_t threads = 1 ; ; threads = std::min(threads * 2, topo.cpus.size())) {
+    worker_pool pool(pick_cpus(topo, threads));
+    auto sharded = shard_forest2(f2, pool);
+    run("rf_eval_parallel", n_, 1, threads, 40.0 * n_, [&]() { return rf_eval_parallel(sharded, &x_[0], pool); });
+    // the caller is one of parallel_for's threads
+    worker_pool helpers(pick_cpus(others, threads - 1));
+    for(size_t rows : config.rows) {
+      run("rf_eval_parallel_batch", n_, rows, threads, 40.0 * n_ * rows, [&]() {
+	rf_eval_parallel_batch(soa, &batch_[0], rows, NUM_PREDS, &out[0], helpers);
+	return out[0];
+      });
+    }
+    if(threads == topo.cpus.size()) {
+      break;
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if(argc > 1 && strcmp(argv[1], "--check") == 0) {
+    size_t rounds = argc > 2 ? strtoull(argv[2], nullptr, 10) : 200;
+    uint64_t seed = argc > 3 ? strtoull(argv[3], nullptr, 10) : 1;
+    return run_checks(rounds, seed) ? 1 : 0;
+  }
+
+  bool quick = false;
+  for(int i = 1 ; i < argc ; ++i) {
+    if(strcmp(argv[i], "--quick") == 0) {
+      quick = true;
+    } else {
+      config.filter = argv[i];
+    }
+  }
+  if(quick) {
+    config = { { 1 << 10, 1 << 14, 1 << 18 }, { 1, 16 }, 50 * 1000 * 1000, config.filter };
+  } else {
+    config = { { 1 << 10, 1 << 14, 1 << 18, 1 << 22 }, { 1, 16, 128 }, 200 * 1000 * 1000, config.filter };
+  }
+
+  std::mt19937_64 g(1234);
+  std::uniform_real_distribution<float> d(-0.1, 0.1);
+  std::vector<float> x(NUM_PREDS), batch(config.rows.back() * NUM_PREDS);
+  for(auto &v : x) {
+    v = d(g);
+  }
+  for(auto &v : batch) {
+    v = d(g);
+  }
+
+  perf_counters c;
+  counters = &c;
+  std::cout << isa_name(selected_isa()) << " kernels, " << get_topology().cpus.size() << " cpus, "
+	    << (uint64_t)(config.budget / 1000000) << "ms per measurement" << std::endl;
+  if(!c.hardware()) {
+    std::cout << "no hardware counters (" << c.error() << "), leaving those columns out" << std::endl;
+  }
+  {
+    forest2_soa probe(forest2(8));
+    gpu_forest2 gpu(probe);
+    if(!gpu.on_device()) {
+      std::cout << "no gpu (" << gpu.error() << "), rf_eval_gpu_batch runs on the cpu" << std::endl;
+    }
+  }
+  header();
+  for(size_t n : config.sizes) {
+    bench_stumps(n, x);
+    bench_forest2(n, x, batch);
+  }
+
+  return 0;
+}
@@ -0,0 +1,91 @@
+//
+// benchmark harness shared by the test programs and bench.cc
+//
+// every call is timed on its own with get_ts (the monotonic clock), after untimed warmup calls that fault
+// the pages in and warm the caches and predictors.  every result goes through keep() so the compiler can't
+// drop the work, and the report is the median and p99 of the calls rather than the mean, which a single
+// context switch can move a long way
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+// makes v_ look used to the optimizer, without generating any code
+template<typename T>
+inline void keep(const T &v_)
+{
+  asm volatile("" : : "r,m"(v_) : "memory");
+}
+
+struct bench_stats {
+  size_t trials = 0;
+  double median = 0.0, p99 = 0.0, min = 0.0, mean = 0.0;  // nanoseconds per call
+  double val = 0.0;                                        // what the last call returned
+};
+
+inline bench_stats summarize(std::vector<int64_t> &times_)
+{
+  bench_stats s;
+  s.trials = times_.size();
+  if(times_.empty()) {
+    return s;
+  }
+  std::sort(times_.begin(), times_.end());
+  size_t n = times_.size();
+  s.median = n % 2 ? times_[n / 2] : (times_[n / 2 - 1] + times_[n / 2]) / 2.0;
+  s.p99 = times_[std::min(n - 1, (size_t)std::ceil(0.99 * n) - 1)];
+  s.min = times_[0];
+  double total = 0.0;
+  for(int64_t t : times_) {
+    total += t;
+  }
+  s.mean = total / n;
+  return s;
+}
+
+// as many timed calls of f_ as fit in budget_ns_, but at least min_trials_ and at most max_trials_
+template<typename FUNC>
+bench_stats measure_for(FUNC f_, int64_t budget_ns_, size_t min_trials_ = 5, size_t max_trials_ = 10000, size_t warmup_ = 1)
+{
+  for(size_t i = 0 ; i < warmup_ ; ++i) {
+    keep(f_());
+  }
+  std::vector<int64_t> times;
+  double val = 0.0;
+  int64_t begin = get_ts();
+  while(times.size() < max_trials_ && (times.size() < min_trials_ || get_ts() - begin < budget_ns_)) {
+    int64_t start = get_ts();
+    val = f_();
+    keep(val);
+    times.push_back(get_ts() - start);
+  }
+  bench_stats s = summarize(times);
+  s.val = val;
+  return s;
+}
+
+// exactly trials_ timed calls
+template<typename FUNC>
+bench_stats measure(FUNC f_, size_t trials_, size_t warmup_ = 1)
+{
+  return measure_for(f_, 0, trials_, trials_, warmup_);
+}
+
+// measure f_ and print one line for it (what the test programs report)
+template<typename FUNC>
+bench_stats timer(FUNC f_, size_t trials_, const std::string &name_)
+{
+  bench_stats s = measure(f_, trials_);
+  std::cout << (uint64_t)s.median << " nanos/trial median, " << (uint64_t)s.p99 << " p99 (" << trials_ << " trials) for "
+	    << name_ << " (val=" << s.val << ")" << std::endl;
+  return s;
+}
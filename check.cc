@@ -0,0 +1,709 @@
+//
+// fuzzed equivalence checks of every kernel against the scalar references (see check.h)
+//
+
+#include "check.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "anytime.h"
+#include "compile.h"
+#include "conditions.h"
+#include "check_forest.h"
+#include "cpu.h"
+#include "engine.h"
+#include "flat_forest.h"
+#include "forest.h"
+#include "forest_soa.h"
+#include "gen/check_model.h"
+#include "gen/check_model_scalar.h"
+#include "gpu.h"
+#include "half.h"
+#include "multi_output.h"
+#include "numa.h"
+#include "parallel.h"
+#include "pool.h"
+#include "quantize.h"
+#include "quickscorer.h"
+#include "reorder.h"
+#include "simd_forest.h"
+#include "stream.h"
+#include "stumps.h"
+
+static const double U = 0x1p-24;       // float unit roundoff
+static const double UD = 0x1p-53;      // double unit roundoff
+static const size_t MAX_REPORTED = 20;
+
+// the bounds of check.h, for the mean of n_ selected leaves whose magnitudes add up to s_
+static double gamma_n(size_t n_)
+{
+  return n_ * U / (1 - n_ * U);
+}
+
+// float lane sums, plus the division and the rounding of the result
+static double float_bound(size_t n_, double s_)
+{
+  return gamma_n(n_ + 2) * s_ / n_;
+}
+
+// kahan lane sums added up in double, then divided and rounded to float
+static double compensated_bound(size_t n_, double s_)
+{
+  return (3 * U + n_ * U * U) * s_ / n_;
+}
+
+// double sums of float leaves, the leaves of a pair of trees possibly added in float first
+static double double_bound(size_t n_, double s_)
+{
+  return (U + 2 * (n_ + 2) * UD) * s_ / n_;
+}
+
+struct backend_stats {
+  size_t cases = 0;
+  size_t failures = 0;
+  double worst = 0.0;      // largest error / bound
+};
+
+static std::map<std::string, backend_stats> stats;
+static size_t failed;
+
+// one comparison of backend name_ against the reference, what_ describes the case for the report
+static void expect(const std::string &name_, double got_, double want_, double bound_, const std::string &what_)
+{
+  backend_stats &s = stats[name_];
+  ++s.cases;
+  double err = std::fabs(got_ - want_);
+  bool ok = got_ == want_ || err <= bound_;
+  if(bound_ > 0) {
+    s.worst = std::max(s.worst, ok ? err / bound_ : INFINITY);
+  } else if(!ok) {
+    s.worst = INFINITY;
+  }
+  if(ok) {
+    return;
+  }
+  ++s.failures;
+  if(failed++ < MAX_REPORTED) {
+    std::cout << "FAIL " << name_ << " " << what_ << ": got " << std::setprecision(17) << got_ << ", want " << want_
+	      << " (error " << err << ", bound " << bound_ << ")" << std::defaultfloat << std::endl;
+  }
+}
+
+struct fuzz {
+  std::mt19937_64 g;
+
+  explicit fuzz(uint64_t seed_) : g(seed_) {}
+
+  size_t below(size_t n_) { return g() % n_; }
+  bool chance(double p_) { return std::uniform_real_distribution<double>(0, 1)(g) < p_; }
+
+  // a float of either sign over a few orders of magnitude, so sums have something to lose
+  float value() {
+    float v = std::uniform_real_distribution<float>(-1, 1)(g);
+    return std::ldexp(v, (int)below(13) - 6);
+  }
+
+  // a feature value: about 3% NaN
+  float feature() {
+    return chance(0.03) ? NAN : value();
+  }
+
+  // a ready aligned_vector holding count_ values starting off_ floats past its start, off_ < 8
+  template<typename T, typename GEN>
+  const T *array(aligned_vector<T> &v_, size_t count_, size_t off_, GEN gen_) {
+    v_.assign(count_ + 8, T());
+    for(size_t i = 0 ; i < count_ ; ++i) {
+      v_[off_ + i] = gen_();
+    }
+    return &v_[off_];
+  }
+};
+
+static std::string describe(const std::string &what_, size_t n_, uint64_t seed_)
+{
+  std::ostringstream s;
+  s << "(" << what_ << " " << n_ << ", seed " << seed_ << ")";
+  return s.str();
+}
+
+// the reference every stump kernel is held to: the mean in double and the sum of magnitudes
+template<typename A>
+static double ref_select(const A *a, const A *b, const float *x, const float *y, size_t count, double &s_)
+{
+  double total = 0.0;
+  s_ = 0.0;
+  for(size_t i = 0 ; i < count ; ++i) {
+    float v = a[i] <= b[i] ? x[i] : y[i];
+    total += v;
+    s_ += std::fabs(v);
+  }
+  return total / count;
+}
+
+static void check_select(fuzz &z_, uint64_t seed_)
+{
+  const size_t count = z_.chance(0.02) ? 100000 + z_.below(1000) : 1 + z_.below(3000);
+  const std::string what = describe("count", count, seed_);
+  aligned_vector<float> va, vb, vx, vy;
+  const float *b = z_.array(vb, count, z_.below(8), [&]() { return z_.value(); });
+  const float *x = z_.array(vx, count, z_.below(8), [&]() { return z_.value(); });
+  const float *y = z_.array(vy, count, z_.below(8), [&]() { return z_.value(); });
+  // a quarter of the a's tie with their b, so <= and < would differ
+  size_t i = 0;
+  const float *a = z_.array(va, count, z_.below(8), [&]() {
+    float v = z_.chance(0.25) ? b[i] : z_.feature();
+    ++i;
+    return v;
+  });
+
+  double s;
+  const double want = ref_select(a, b, x, y, count, s);
+  const bool was = compensated_sums();
+  for(bool comp : { false, true }) {
+    set_compensated_sums(comp);
+    const double bound = comp ? compensated_bound(count, s) : float_bound(count, s);
+    const std::string suffix = comp ? " compensated" : "";
+    expect("selectf" + suffix, selectf(a, b, x, y, count), want, bound, what);
+    expect("selectf2" + suffix, selectf2(a, b, x, y, count), want, bound, what);
+#if defined(__x86_64__)
+    expect("selectf_avx2" + suffix, selectf_avx2(a, b, x, y, count), want, bound, what);
+#endif
+
+    // a batch of rows at a random stride, each row its own a
+    const size_t rows = 1 + z_.below(9);
+    const size_t stride = count + z_.below(9);
+    aligned_vector<float> batch(rows * stride + 8);
+    float *base = &batch[z_.below(8)];
+    std::vector<double> wants(rows), ss(rows);
+    for(size_t r = 0 ; r < rows ; ++r) {
+      for(size_t j = 0 ; j < count ; ++j) {
+	base[r * stride + j] = z_.chance(0.25) ? b[j] : z_.feature();
+      }
+      wants[r] = ref_select(base + r * stride, b, x, y, count, ss[r]);
+    }
+    std::vector<float> out(rows);
+    selectf_batch(base, stride, b, x, y, count, rows, &out[0]);
+    for(size_t r = 0 ; r < rows ; ++r) {
+      expect("selectf_batch" + suffix, out[r], wants[r], comp ? compensated_bound(count, ss[r]) : float_bound(count, ss[r]),
+	     what);
+    }
+  }
+  set_compensated_sums(was);
+  expect("selectslow", selectslow(a, b, x, y, count), want, float_bound(count, s), what);
+
+  // the quantized versions, with bins in place of values
+  aligned_vector<int8_t> qa8, qb8;
+  aligned_vector<int16_t> qa16, qb16;
+  const int8_t *b8 = z_.array(qb8, count, z_.below(8), [&]() { return (int8_t)z_.below(128); });
+  i = 0;
+  const int8_t *a8 = z_.array(qa8, count, z_.below(8), [&]() {
+    int8_t v = z_.chance(0.25) ? b8[i] : z_.below(128);
+    ++i;
+    return v;
+  });
+  const int16_t *b16 = z_.array(qb16, count, z_.below(8), [&]() { return (int16_t)z_.below(32768); });
+  i = 0;
+  const int16_t *a16 = z_.array(qa16, count, z_.below(8), [&]() {
+    int16_t v = z_.chance(0.25) ? b16[i] : z_.below(32768);
+    ++i;
+    return v;
+  });
+  double want8 = ref_select(a8, b8, x, y, count, s);
+  expect("selectq int8", selectq(a8, b8, x, y, count), want8, float_bound(count, s), what);
+  double want16 = ref_select(a16, b16, x, y, count, s);
+  expect("selectq int16", selectq(a16, b16, x, y, count), want16, float_bound(count, s), what);
+}
+
+// a feature row of num_preds_ values
+static std::vector<float> make_row(fuzz &z_, size_t num_preds_)
+{
+  std::vector<float> x(num_preds_);
+  for(auto &v : x) {
+    v = z_.feature();
+  }
+  return x;
+}
+
+// a split value on predictor var_, a copy of the row's value (a tie) a quarter of the time
+static float split_for(fuzz &z_, const std::vector<float> &x_, size_t var_)
+{
+  return z_.chance(0.25) && !std::isnan(x_[var_]) ? x_[var_] : z_.value();
+}
+
+static double ref_stumps(const stump_forest &f_, const float *x_, double &s_)
+{
+  double total = 0.0;
+  s_ = 0.0;
+  for(size_t i = 0 ; i < f_.size ; ++i) {
+    float v = x_[f_.splitVarID[i]] <= f_.splitValue[i] ? f_.left[i] : f_.right[i];
+    total += v;
+    s_ += std::fabs(v);
+  }
+  return total / f_.size;
+}
+
+static void check_stumps(fuzz &z_, uint64_t seed_, worker_pool &pool_)
+{
+  const size_t count = 1 + z_.below(3000);
+  const size_t np = 1 + z_.below(300);
+  const std::string what = describe("stumps", count, seed_);
+  std::vector<float> x = make_row(z_, np);
+  stump_forest f;
+  for(size_t i = 0 ; i < count ; ++i) {
+    uint32_t var = z_.below(np);
+    f.push_back(var, split_for(z_, x, var), z_.value(), z_.value());
+  }
+
+  double s;
+  const double want = ref_stumps(f, &x[0], s);
+  expect("rf_eval_stumps", rf_eval_stumps(f, &x[0]), want, double_bound(count, s), what);
+  auto sharded = shard_stumps(f, pool_);
+  expect("rf_eval_parallel stumps", rf_eval_parallel(sharded, &x[0], pool_), want, double_bound(count, s), what);
+
+  // the 16-bit forests against a forest of the same rounded values
+  for(half_format fmt : { half_format::fp16, half_format::bf16 }) {
+    stump_forest_half h(f, fmt);
+    stump_forest r;
+    for(size_t i = 0 ; i < count ; ++i) {
+      r.push_back(f.splitVarID[i], from_half(to_half(f.splitValue[i], fmt), fmt), from_half(to_half(f.left[i], fmt), fmt),
+		  from_half(to_half(f.right[i], fmt), fmt));
+    }
+    double rs;
+    double rwant = ref_stumps(r, &x[0], rs);
+    expect(std::string("rf_eval_stumps_half ") + half_format_name(fmt), rf_eval_stumps_half(h, &x[0]), rwant,
+	   double_bound(count, rs), what);
+  }
+}
+
+static float ref_tree2(const tree2 &t_, const float *x_)
+{
+  if(x_[t_.a_splitVarID] <= t_.b_splitValue) {
+    return x_[t_.c_splitVarID] <= t_.d_splitValue ? t_.one : t_.two;
+  }
+  return x_[t_.e_splitVarID] <= t_.f_splitValue ? t_.three : t_.four;
+}
+
+static double ref_forest2(const forest2 &f_, const float *x_, double &s_)
+{
+  double total = 0.0;
+  s_ = 0.0;
+  for(const auto &t : f_) {
+    float v = ref_tree2(t, x_);
+    total += v;
+    s_ += std::fabs(v);
+  }
+  return total / f_.size();
+}
+
+static tree unpack_tree2(const tree2 &t_)
+{
+  return { { 1, 2, t_.a_splitVarID, t_.b_splitValue }, { 3, 4, t_.c_splitVarID, t_.d_splitValue },
+	   { 5, 6, t_.e_splitVarID, t_.f_splitValue }, { 0, 0, 0, t_.one }, { 0, 0, 0, t_.two },
+	   { 0, 0, 0, t_.three }, { 0, 0, 0, t_.four } };
+}
+
+// a column_source over the column-major rows_ x num_preds_ matrix xc_, with a random validity bitmap on
+// some columns; the nulls are written into the row-major copy xr_ as NaN so the reference sees them
+static column_source make_columns(fuzz &z_, const std::vector<float> &xc_, std::vector<float> &xr_, size_t rows_,
+				  size_t num_preds_, std::vector<std::vector<uint8_t>> &validity_)
+{
+  column_source src;
+  src.rows = rows_;
+  validity_.assign(num_preds_, {});
+  for(size_t j = 0 ; j < num_preds_ ; ++j) {
+    feature_column c = { &xc_[j * rows_] };
+    if(z_.chance(0.3)) {
+      const size_t off = z_.below(8);
+      validity_[j].resize((rows_ + off + 7) / 8 + 1);
+      for(auto &byte : validity_[j]) {
+	byte = z_.g();
+      }
+      c.validity = &validity_[j][0];
+      c.validity_offset = off;
+      for(size_t r = 0 ; r < rows_ ; ++r) {
+	size_t bit = off + r;
+	if(!((validity_[j][bit >> 3] >> (bit & 7)) & 1)) {
+	  xr_[r * num_preds_ + j] = NAN;
+	}
+      }
+    }
+    src.columns.push_back(c);
+  }
+  return src;
+}
+
+template<size_t D>
+static void check_simd_forest(const std::vector<tree> &f_, const std::vector<float> &x_, double want_, double bound_,
+			      const std::string &suffix_, const std::string &what_)
+{
+  simd_forest<D> sf = compile_forest<D>(f_);
+  expect("rf_eval_simd<Depth>" + suffix_, rf_eval_simd(sf, x_), want_, bound_, what_);
+}
+
+static void check_forest2(fuzz &z_, uint64_t seed_, worker_pool &pool_)
+{
+  const size_t count = 2 * (1 + z_.below(1500));
+  const size_t np = 1 + z_.below(300);
+  const std::string what = describe("depth 2 trees", count, seed_);
+  std::vector<float> x = make_row(z_, np);
+  forest2 f(count);
+  for(auto &t : f) {
+    t.a_splitVarID = z_.below(np);
+    t.c_splitVarID = z_.below(np);
+    t.e_splitVarID = z_.below(np);
+    t.b_splitValue = split_for(z_, x, t.a_splitVarID);
+    t.d_splitValue = split_for(z_, x, t.c_splitVarID);
+    t.f_splitValue = split_for(z_, x, t.e_splitVarID);
+    t.one = z_.value();
+    t.two = z_.value();
+    t.three = z_.value();
+    t.four = z_.value();
+  }
+  forest2_soa soa(f);
+
+  double s;
+  const double want = ref_forest2(f, &x[0], s);
+  const double bound = double_bound(count, s);
+  expect("rf_eval_simd", rf_eval_simd(f, x), want, bound, what);
+  expect("rf_eval_simd_gather", rf_eval_simd_gather(f, x), want, bound, what);
+  expect("rf_eval_soa", rf_eval_soa(soa, x), want, bound, what);
+  expect("rf_eval_soa reordered", rf_eval_soa(forest2_soa(reorder_forest2(f)), x), want, bound, what);
+  {
+    // NaN thresholds send everything right and must sort like any other
+    forest2 nan = f;
+    for(auto &t : nan) {
+      if(z_.chance(0.1)) {
+	t.b_splitValue = NAN;
+      }
+      if(z_.chance(0.1)) {
+	t.d_splitValue = NAN;
+      }
+    }
+    double ns;
+    const double nwant = ref_forest2(nan, &x[0], ns);
+    expect("rf_eval_soa reordered NaN splits", rf_eval_soa(forest2_soa(reorder_forest2(nan)), x), nwant,
+	   double_bound(count, ns), what);
+  }
+  {
+    auto sharded = shard_forest2(f, pool_);
+    expect("rf_eval_parallel", rf_eval_parallel(sharded, &x[0], pool_), want, bound, what);
+  }
+  for(half_format fmt : { half_format::fp16, half_format::bf16 }) {
+    forest2 r = f;
+    for(auto &t : r) {
+      for(float *v : { &t.b_splitValue, &t.d_splitValue, &t.f_splitValue, &t.one, &t.two, &t.three, &t.four }) {
+	*v = from_half(to_half(*v, fmt), fmt);
+      }
+    }
+    double rs;
+    double rwant = ref_forest2(r, &x[0], rs);
+    expect(std::string("rf_eval_soa_half ") + half_format_name(fmt), rf_eval_soa_half(forest2_soa_half(soa, fmt), &x[0]),
+	   rwant, double_bound(count, rs), what);
+  }
+  {
+    feature_bins bins(soa, np);
+    quantized_soa q(soa, bins);
+    std::vector<int16_t> qx(np + 1);
+    bins.quantize(&x[0], &qx[0]);
+    expect("rf_eval_quantized", rf_eval_quantized(q, &qx[0]), want, bound, what);
+  }
+  {
+    condition_forest c(soa, np);
+    std::vector<uint32_t> bits(c.words());
+    c.evaluate(&x[0], &bits[0]);
+    expect("rf_eval_conditions", rf_eval_conditions(c, &bits[0]), want, bound, what);
+  }
+  {
+    // output k is every leaf times a power of two and a sign, which is exact
+    const size_t outputs = 1 + z_.below(MULTI_MAX_OUTPUTS);
+    auto scale = [](size_t k_) { return std::ldexp(k_ & 1 ? -1.0f : 1.0f, k_ % 4); };
+    multi_forest2 m(outputs);
+    std::vector<float> leaves(4 * outputs);
+    for(const auto &t : f) {
+      const float l[4] = { t.one, t.two, t.three, t.four };
+      for(size_t j = 0 ; j < 4 ; ++j) {
+	for(size_t k = 0 ; k < outputs ; ++k) {
+	  leaves[j * outputs + k] = l[j] * scale(k);
+	}
+      }
+      m.push_back(t, &leaves[0]);
+    }
+    std::vector<double> out(outputs);
+    rf_eval_multi(m, &x[0], &out[0]);
+    for(size_t k = 0 ; k < outputs ; ++k) {
+      expect("rf_eval_multi", out[k], want * scale(k), bound * std::fabs(scale(k)), what);
+    }
+  }
+  {
+    // unit weights, then random ones (folded into the leaves as float products, which the reference copies)
+    anytime_forest unit(f);
+    expect("rf_sum_weighted", rf_sum_weighted(unit, &x[0]) / count, want, bound, what);
+
+    std::vector<float> weights(count);
+    forest2 w = f;
+    for(size_t i = 0 ; i < count ; ++i) {
+      weights[i] = std::uniform_real_distribution<float>(0, 2)(z_.g);
+      for(float *v : { &w[i].one, &w[i].two, &w[i].three, &w[i].four }) {
+	*v *= weights[i];
+      }
+    }
+    const double bias = z_.value();
+    double ws;
+    const double full = ref_forest2(w, &x[0], ws) * count + bias;
+    anytime_forest weighted(f, weights, bias);
+    expect("rf_sum_weighted weights", rf_sum_weighted(weighted, &x[0]), full, double_bound(count, ws) * count, what);
+
+    // stopping early must only claim a decision the full sum agrees with
+    anytime_budget budget;
+    budget.max_trees = z_.below(count + 1);
+    budget.threshold = full + z_.value() * ws / 16;
+    anytime_result res = rf_score_anytime(weighted, &x[0], budget);
+    if(res.decided && std::fabs(full - *budget.threshold) > double_bound(count, ws) * count) {
+      expect("rf_score_anytime decided", (res.margin > *budget.threshold) == (full > *budget.threshold), 1, 0, what);
+    }
+  }
+  {
+    std::vector<tree> nodes;
+    for(const auto &t : f) {
+      nodes.push_back(unpack_tree2(t));
+    }
+    expect("rf_eval_flat", rf_eval_flat(flat_forest(nodes), &x[0]), want, bound, what);
+    expect("rf_eval_quickscorer", rf_eval_quickscorer(quickscorer_forest(nodes, np), x), want, bound, what);
+    expect("rf_eval_engine", rf_eval_engine(forest_engine(nodes, np), x), want, bound, what);
+  }
+
+  // batches of rows, row and column major, and the stream over columns
+  const size_t rows = 1 + z_.below(40);
+  std::vector<float> xr(rows * np), xc(rows * np);
+  for(size_t r = 0 ; r < rows ; ++r) {
+    std::vector<float> row = make_row(z_, np);
+    for(size_t j = 0 ; j < np ; ++j) {
+      xr[r * np + j] = xc[j * rows + r] = z_.chance(0.1) ? x[j] : row[j];
+    }
+  }
+  std::vector<double> out(rows);
+  auto check_rows = [&](const char *name_, const std::vector<float> &x_) {
+    for(size_t r = 0 ; r < rows ; ++r) {
+      double rs;
+      double rwant = ref_forest2(f, &x_[r * np], rs);
+      expect(name_, out[r], rwant, double_bound(count, rs), what);
+    }
+  };
+  const size_t tile = 1 + z_.below(2 * RF_BATCH_TILE);
+  rf_eval_simd_batch(f, &xr[0], rows, np, sample_layout::row_major, &out[0], tile);
+  check_rows("rf_eval_simd_batch row_major", xr);
+  rf_eval_simd_batch(f, &xc[0], rows, np, sample_layout::col_major, &out[0], tile);
+  check_rows("rf_eval_simd_batch col_major", xr);
+  rf_eval_parallel_batch(soa, &xr[0], rows, np, &out[0], pool_);
+  check_rows("rf_eval_parallel_batch", xr);
+  {
+    // no minimum batch, so every batch goes to the device when there is one
+    gpu_forest2 gpu(soa, 0);
+    rf_eval_gpu_batch(gpu, &xr[0], rows, np, &out[0], pool_);
+    check_rows(gpu.on_device() ? "rf_eval_gpu_batch" : "rf_eval_gpu_batch (cpu fallback)", xr);
+  }
+
+  std::vector<std::vector<uint8_t>> validity;
+  column_source src = make_columns(z_, xc, xr, rows, np, validity);
+  const size_t block = 1 + z_.below(rows + 4);
+  rf_eval_stream(f, src, &out[0], block);
+  check_rows("rf_eval_stream tree2", xr);
+  rf_eval_stream(soa, src, &out[0], block);
+  check_rows("rf_eval_stream soa", xr);
+
+  // and stumps made of the top splits, streamed over the same columns
+  stump_forest st;
+  for(const auto &t : f) {
+    st.push_back(t.a_splitVarID, t.b_splitValue, t.one, t.four);
+  }
+  rf_eval_stream(st, src, &out[0], block);
+  for(size_t r = 0 ; r < rows ; ++r) {
+    double rs;
+    double rwant = ref_stumps(st, &xr[r * np], rs);
+    expect("rf_eval_stream stumps", out[r], rwant, double_bound(count, rs), what);
+  }
+  // the batch is rf_eval_stumps row by row, to the bit
+  rf_eval_stumps_batch(st, &xr[0], rows, np, &out[0]);
+  for(size_t r = 0 ; r < rows ; ++r) {
+    expect("rf_eval_stumps_batch", out[r], rf_eval_stumps(st, &xr[r * np]), 0, what);
+  }
+}
+
+// a random tree of depth at most depth_, node 0 the root
+static void grow(fuzz &z_, tree &t_, size_t id_, size_t depth_, size_t num_preds_, const std::vector<float> &x_)
+{
+  if(depth_ == 0 || z_.chance(0.25)) {
+    t_[id_] = { 0, 0, 0, z_.value() };
+    return;
+  }
+  uint32_t var = z_.below(num_preds_);
+  size_t left = t_.size();
+  t_.resize(t_.size() + 2);
+  t_[id_] = { left, left + 1, var, split_for(z_, x_, var) };
+  grow(z_, t_, left, depth_ - 1, num_preds_, x_);
+  grow(z_, t_, left + 1, depth_ - 1, num_preds_, x_);
+}
+
+static float ref_tree(const tree &t_, const float *x_)
+{
+  const node *n = &t_[0];
+  while(n->leftChildNodeID || n->rightChildNodeID) {
+    n = &t_[x_[n->splitVarID] <= n->splitValue ? n->leftChildNodeID : n->rightChildNodeID];
+  }
+  return n->splitValue;
+}
+
+// every kernel taking node lists against ref_tree
+static void check_nodes(const std::vector<tree> &f_, const std::vector<float> &x_, size_t num_preds_,
+			const std::string &suffix_, const std::string &what_)
+{
+  double total = 0.0, s = 0.0;
+  for(const auto &t : f_) {
+    float v = ref_tree(t, &x_[0]);
+    total += v;
+    s += std::fabs(v);
+  }
+  const double want = total / f_.size();
+  const double bound = double_bound(f_.size(), s);
+  expect("rf_eval" + suffix_, rf_eval(f_, x_), want, bound, what_);
+  expect("rf_eval_flat" + suffix_, rf_eval_flat(flat_forest(f_), &x_[0]), want, bound, what_);
+  expect("rf_eval_quickscorer" + suffix_, rf_eval_quickscorer(quickscorer_forest(f_, num_preds_), x_), want, bound, what_);
+  expect("rf_eval_engine" + suffix_, rf_eval_engine(forest_engine(f_, num_preds_), x_), want, bound, what_);
+
+  switch(std::max<size_t>(1, forest_depth(f_))) {
+  case 1: check_simd_forest<1>(f_, x_, want, bound, suffix_, what_); break;
+  case 2: check_simd_forest<2>(f_, x_, want, bound, suffix_, what_); break;
+  case 3: check_simd_forest<3>(f_, x_, want, bound, suffix_, what_); break;
+  case 4: check_simd_forest<4>(f_, x_, want, bound, suffix_, what_); break;
+  case 5: check_simd_forest<5>(f_, x_, want, bound, suffix_, what_); break;
+  case 6: check_simd_forest<6>(f_, x_, want, bound, suffix_, what_); break;
+  case 7: check_simd_forest<7>(f_, x_, want, bound, suffix_, what_); break;
+  default: check_simd_forest<8>(f_, x_, want, bound, suffix_, what_); break;
+  }
+}
+
+static void check_deep(fuzz &z_, uint64_t seed_)
+{
+  const size_t count = 1 + z_.below(300);
+  const size_t np = 1 + z_.below(300);
+  const size_t max_depth = z_.below(QUICKSCORER_MAX_DEPTH + 1);
+  const std::string what = describe("trees of depth <= " + std::to_string(max_depth) + ", count", count, seed_);
+  std::vector<float> x = make_row(z_, np);
+  std::vector<tree> f(count);
+  for(auto &t : f) {
+    t.resize(1);
+    grow(z_, t, 0, z_.below(max_depth + 1), np, x);
+  }
+
+  check_nodes(f, x, np, "", what);
+
+  // +inf splits, which every number passes, against a row of mostly NaNs, which fail every test
+  for(auto &t : f) {
+    for(auto &n : t) {
+      if((n.leftChildNodeID || n.rightChildNodeID) && z_.chance(0.2)) {
+	n.splitValue = INFINITY;
+      }
+    }
+  }
+  for(auto &v : x) {
+    if(z_.chance(0.5)) {
+      v = NAN;
+    }
+  }
+  check_nodes(f, x, np, " inf splits", what);
+}
+
+// forestc's output for the fixed forest of check_forest.h: the avx2 code must be rf_sum_soa_avx2 to the bit,
+// and the fallback, which sums in tree order, the reference to the bit
+static void check_codegen(fuzz &z_, uint64_t seed_)
+{
+  static const forest2 f = check_forest();
+  static const forest2_soa soa(f);
+  const std::string what = describe("forestc check_model", f.size(), seed_);
+  std::vector<float> x = make_row(z_, CHECK_FOREST_PREDS);
+  for(size_t i = 0 ; i < 8 ; ++i) {
+    const tree2 &t = f[z_.below(f.size())];
+    x[t.a_splitVarID] = t.b_splitValue;
+    x[t.c_splitVarID] = t.d_splitValue;
+  }
+
+  double s;
+  const double want = ref_forest2(f, &x[0], s);
+  expect("forestc fallback", check_model_scalar_eval(&x[0]), want, 0, what);
+#if defined(__x86_64__)
+  expect("forestc avx2", check_model_sum(&x[0]), rf_sum_soa_avx2(soa.view(), &x[0]), 0, what);
+#else
+  expect("forestc fallback", check_model_eval(&x[0]), want, 0, what);
+#endif
+  expect("forestc vs rf_eval_soa", check_model_eval(&x[0]), rf_eval_soa(soa, x), double_bound(f.size(), s), what);
+}
+
+// run_wait on a pool another thread holds: every task must still land on a worker, not on the caller
+static void check_run_wait(worker_pool &pool_)
+{
+  if(pool_.size() == 0) {
+    return;
+  }
+  std::atomic<bool> holding{false};
+  std::thread holder([&]() {
+    pool_.parallel_for(1, [&](size_t) {
+      holding = true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    });
+  });
+  while(!holding) {
+    std::this_thread::yield();
+  }
+  const std::thread::id caller = std::this_thread::get_id();
+  std::atomic<size_t> on_caller{0};
+  pool_.run_wait(4 * pool_.size(), [&](size_t) {
+    if(std::this_thread::get_id() == caller) {
+      ++on_caller;
+    }
+  });
+  holder.join();
+  expect("run_wait on a busy pool", on_caller, 0, 0, std::to_string(pool_.size()) + " workers");
+}
+
+size_t run_checks(size_t rounds_, uint64_t seed_)
+{
+  stats.clear();
+  failed = 0;
+  cpu_topology topo = get_topology();
+  worker_pool one(pick_cpus(topo, 1));
+  std::cout << isa_name(selected_isa()) << " kernels, " << rounds_ << " rounds from seed " << seed_ << std::endl;
+  check_run_wait(one);
+  check_run_wait(default_pool());
+
+  for(size_t r = 0 ; r < rounds_ ; ++r) {
+    // every round is reproducible on its own from its seed, which the failures print
+    const uint64_t seed = seed_ + r;
+    fuzz z(seed);
+    worker_pool &pool = r & 1 ? default_pool() : one;
+    check_select(z, seed);
+    check_stumps(z, seed, pool);
+    check_forest2(z, seed, pool);
+    check_deep(z, seed);
+    check_codegen(z, seed);
+  }
+
+  std::cout << std::left << std::setw(34) << "backend" << std::right << std::setw(9) << "cases" << std::setw(10) << "failures"
+	    << std::setw(16) << "worst err/bound" << std::endl;
+  for(const auto &[name, s] : stats) {
+    std::cout << std::left << std::setw(34) << name << std::right << std::setw(9) << s.cases << std::setw(10) << s.failures
+	      << std::setw(16) << std::setprecision(3) << s.worst << std::defaultfloat << std::endl;
+  }
+  std::cout << (failed ? std::to_string(failed) + " failed comparisons" : std::string("all passed")) << std::endl;
+  return failed;
+}
@@ -0,0 +1,25 @@
+//
+// fuzzed equivalence checks of every kernel against the scalar references (run by bench --check)
+//
+// each round builds random forests (stumps, depth 2 and random shapes down to depth 8) of random sizes at
+// random alignments, and random rows mixing fresh values, copies of split values (ties, where <= and <
+// part ways) and NaNs (which must go right everywhere).  every backend scores them and is compared with
+// the reference, computed in double, under an explicit bound for how it sums, with u = 2^-24 and S the
+// sum of the magnitudes of the selected leaves:
+//
+// float lane sums (selectslow, selectf, selectf2, selectf_batch, selectq) : gamma(n) S, gamma(n) = nu / (1 - nu)
+// the same with compensated sums on                                     : (2u + nu^2) S
+// double sums of float leaves (everything else)                          : (u + n 2^-52) S
+//
+// plus one float rounding of the result for the kernels that return float.  the 16-bit forests are held to
+// a reference forest with the same rounded values, since rounding a threshold legitimately changes which
+// side a row goes
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// run rounds_ rounds from seed_, print a report per backend and return the number of failed comparisons
+size_t run_checks(size_t rounds_, uint64_t seed_);
@@ -0,0 +1,27 @@
+//
+// check_forest: writes the fixed forest of check_forest.h to a forest file, for make to run forestc on
+//
+// usage: check_forest model.ssf
+//
+
+#include <exception>
+#include <iostream>
+
+#include "check_forest.h"
+#include "forest_file.h"
+#include "forest_soa.h"
+
+int main(int argc, char **argv)
+{
+  if(argc != 2) {
+    std::cerr << "usage: " << argv[0] << " model.ssf" << std::endl;
+    return 2;
+  }
+  try {
+    save_forest2_soa(forest2_soa(check_forest()), argv[1], CHECK_FOREST_PREDS);
+  } catch(const std::exception &e) {
+    std::cerr << argv[0] << ": " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,58 @@
+//
+// the fixed forest make compiles with forestc for check.cc
+//
+// the check_forest program writes it to a forest file, make runs forestc on that (as check_model, and again
+// as check_model_scalar built without avx2, see the Makefile) and the generated code is linked into bench,
+// where check.cc scores it against the kernels on the same forest rebuilt from here
+//
+// the ids, thresholds and leaves come straight off mt19937_64, whose output the standard fixes, so every
+// build sees the same forest.  it has a partial group (and so padding), more groups than one generated
+// function takes, and thresholds of every kind literal() has to spell: ties of several trees on one
+// value, +-0, +-inf and NaN
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+#include "forest.h"
+
+const size_t CHECK_FOREST_SIZE = 1021;
+const size_t CHECK_FOREST_PREDS = 64;
+
+// a value in +-[2^-8, 2^8), from 24 random bits of mantissa
+inline float check_forest_value(std::mt19937_64 &g_)
+{
+  uint64_t r = g_();
+  float v = std::ldexp((float)(r & 0xffffff) / (1 << 24) + 1.0f, (int)((r >> 24) % 16) - 8);
+  return (r >> 28) & 1 ? -v : v;
+}
+
+inline float check_forest_split(std::mt19937_64 &g_)
+{
+  static const float SPECIAL[] = { 0.0f, -0.0f, INFINITY, -INFINITY, NAN, 0.5f, -0.5f };
+  uint64_t r = g_();
+  return r % 8 == 0 ? SPECIAL[(r >> 3) % 7] : check_forest_value(g_);
+}
+
+inline forest2 check_forest()
+{
+  std::mt19937_64 g(2029);
+  forest2 f(CHECK_FOREST_SIZE);
+  for(auto &t : f) {
+    t.a_splitVarID = g() % CHECK_FOREST_PREDS;
+    t.c_splitVarID = g() % CHECK_FOREST_PREDS;
+    t.e_splitVarID = g() % CHECK_FOREST_PREDS;
+    t.b_splitValue = check_forest_split(g);
+    t.d_splitValue = check_forest_split(g);
+    t.f_splitValue = check_forest_split(g);
+    t.one = check_forest_value(g);
+    t.two = check_forest_value(g);
+    t.three = check_forest_value(g);
+    t.four = g() % 8 == 0 ? -0.0f : check_forest_value(g);
+  }
+  return f;
+}
@@ -0,0 +1,180 @@
+//
+// depth-2 forest to c++ compiler (see codegen.h)
+//
+
+#include "codegen.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <type_traits>
+
+// a float literal that reads back as exactly v_
+static std::string literal(float v_)
+{
+  if(std::isnan(v_)) {
+    return "__builtin_nanf(\"\")";
+  }
+  if(std::isinf(v_)) {
+    return v_ > 0 ? "__builtin_inff()" : "-__builtin_inff()";
+  }
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%af", (double)v_);
+  return buf;
+}
+
+// _mm256_setr_ps of 8 consecutive entries of v_, or _mm256_setzero_ps() when they're all +0
+static std::string vector(const float *v_)
+{
+  bool zero = true;
+  std::string s = "_mm256_setr_ps(";
+  for(size_t i = 0 ; i < 8 ; ++i) {
+    zero = zero && v_[i] == 0.0f && !std::signbit(v_[i]);
+    s += (i ? ", " : "") + literal(v_[i]);
+  }
+  return zero ? "_mm256_setzero_ps()" : s + ")";
+}
+
+// a gather of x_ through 8 consecutive ids.  building the vector from 8 scalar loads at constant offsets
+// would drop the index vector, but 24 inserts per group measured slower than the 3 gathers
+static std::string features(const uint32_t *ids_)
+{
+  std::string s = "_mm256_i32gather_ps(x_, _mm256_setr_epi32(";
+  for(size_t i = 0 ; i < 8 ; ++i) {
+    s += (i ? ", " : "") + std::to_string(ids_[i]);
+  }
+  return s + "), 4)";
+}
+
+template<typename T>
+static void table(std::ostream &out_, const char *type_, const std::string &name_, const T *v_, size_t n_)
+{
+  out_ << "constexpr " << type_ << " " << name_ << "[] = {";
+  for(size_t i = 0 ; i < n_ ; ++i) {
+    out_ << (i % 8 ? " " : "\n  ");
+    if constexpr (std::is_same_v<T, float>) {
+      out_ << literal(v_[i]) << ",";
+    } else {
+      out_ << v_[i] << ",";
+    }
+  }
+  out_ << "\n};\n";
+}
+
+void compile_forest2_cpp(const forest2_soa_view &f_, const std::string &name_, std::ostream &header_,
+			 std::ostream &source_, size_t groups_)
+{
+  bool ident = !name_.empty() && !isdigit((unsigned char)name_[0]);
+  for(char c : name_) {
+    ident = ident && (isalnum((unsigned char)c) || c == '_');
+  }
+  if(!ident) {
+    throw std::invalid_argument("'" + name_ + "' is not a c++ identifier");
+  }
+  if(f_.size == 0) {
+    throw std::invalid_argument("can't compile an empty forest");
+  }
+  if(groups_ == 0) {
+    throw std::invalid_argument("compile_forest2_cpp needs at least one group per function");
+  }
+  const size_t groups = f_.padded_size / 8;
+  const size_t parts = (groups + groups_ - 1) / groups_;
+
+  header_ << "// " << name_ << ": a forest of " << f_.size << " depth-2 trees compiled by forestc, do not edit\n"
+	  << "\n"
+	  << "#pragma once\n"
+	  << "\n"
+	  << "#include <cstddef>\n"
+	  << "\n"
+	  << "constexpr size_t " << name_ << "_size = " << f_.size << ";\n"
+	  << "\n"
+	  << "// the sum of the tree predictions (bit for bit rf_sum_soa_avx2's with avx2) and their mean\n"
+	  << "double " << name_ << "_sum(const float *x_);\n"
+	  << "\n"
+	  << "inline double " << name_ << "_eval(const float *x_)\n"
+	  << "{\n"
+	  << "  return " << name_ << "_sum(x_) / " << name_ << "_size;\n"
+	  << "}\n";
+
+  source_ << "// " << name_ << ": a forest of " << f_.size << " depth-2 trees compiled by forestc, do not edit\n"
+	  << "\n"
+	  << "#include \"" << name_ << ".h\"\n"
+	  << "\n"
+	  << "#if defined(__AVX2__)\n"
+	  << "\n"
+	  << "#include <immintrin.h>\n"
+	  << "\n"
+	  << "namespace {\n";
+  for(size_t p = 0 ; p < parts ; ++p) {
+    source_ << "\n"
+	    << "[[gnu::noinline]] void part" << p << "(const float *x_, __m256d &lo_, __m256d &hi_)\n"
+	    << "{\n"
+	    << "  __m256 xa, xc, xe, m1, m2, m3, left, right, res;\n";
+    for(size_t g = p * groups_ ; g < std::min(groups, (p + 1) * groups_) ; ++g) {
+      const size_t i = g * 8;
+      source_ << "\n"
+	      << "  xa = " << features(f_.a_splitVarID + i) << ";\n"
+	      << "  xc = " << features(f_.c_splitVarID + i) << ";\n"
+	      << "  xe = " << features(f_.e_splitVarID + i) << ";\n"
+	      << "  m1 = _mm256_cmp_ps(xa, " << vector(f_.b_splitValue + i) << ", _CMP_NLE_UQ);\n"
+	      << "  m2 = _mm256_cmp_ps(xc, " << vector(f_.d_splitValue + i) << ", _CMP_NLE_UQ);\n"
+	      << "  m3 = _mm256_cmp_ps(xe, " << vector(f_.f_splitValue + i) << ", _CMP_NLE_UQ);\n"
+	      << "  left = _mm256_blendv_ps(" << vector(f_.one + i) << ", " << vector(f_.two + i) << ", m2);\n"
+	      << "  right = _mm256_blendv_ps(" << vector(f_.three + i) << ", " << vector(f_.four + i) << ", m3);\n"
+	      << "  res = _mm256_blendv_ps(left, right, m1);\n"
+	      << "  lo_ = _mm256_add_pd(lo_, _mm256_cvtps_pd(_mm256_castps256_ps128(res)));\n"
+	      << "  hi_ = _mm256_add_pd(hi_, _mm256_cvtps_pd(_mm256_extractf128_ps(res, 1)));\n";
+    }
+    source_ << "}\n";
+  }
+  source_ << "\n"
+	  << "}\n"
+	  << "\n"
+	  << "double " << name_ << "_sum(const float *x_)\n"
+	  << "{\n"
+	  << "  __m256d lo = _mm256_setzero_pd();\n"
+	  << "  __m256d hi = _mm256_setzero_pd();\n";
+  for(size_t p = 0 ; p < parts ; ++p) {
+    source_ << "  part" << p << "(x_, lo, hi);\n";
+  }
+  source_ << "  __m256d total = _mm256_add_pd(lo, hi);\n"
+	  << "  __m128d t = _mm_add_pd(_mm256_castpd256_pd128(total), _mm256_extractf128_pd(total, 1));\n"
+	  << "  return _mm_cvtsd_f64(_mm_add_sd(t, _mm_unpackhi_pd(t, t)));\n"
+	  << "}\n"
+	  << "\n"
+	  << "#else\n"
+	  << "\n"
+	  << "#include <cstdint>\n"
+	  << "\n"
+	  << "namespace {\n"
+	  << "\n";
+  table(source_, "uint32_t", "a", f_.a_splitVarID, f_.size);
+  table(source_, "uint32_t", "c", f_.c_splitVarID, f_.size);
+  table(source_, "uint32_t", "e", f_.e_splitVarID, f_.size);
+  table(source_, "float", "b", f_.b_splitValue, f_.size);
+  table(source_, "float", "d", f_.d_splitValue, f_.size);
+  table(source_, "float", "f", f_.f_splitValue, f_.size);
+  table(source_, "float", "one", f_.one, f_.size);
+  table(source_, "float", "two", f_.two, f_.size);
+  table(source_, "float", "three", f_.three, f_.size);
+  table(source_, "float", "four", f_.four, f_.size);
+  source_ << "\n"
+	  << "}\n"
+	  << "\n"
+	  << "double " << name_ << "_sum(const float *x_)\n"
+	  << "{\n"
+	  << "  double total = 0.0;\n"
+	  << "  for(size_t i = 0 ; i < " << name_ << "_size ; ++i) {\n"
+	  << "    if(x_[a[i]] <= b[i]) {\n"
+	  << "      total += x_[c[i]] <= d[i] ? one[i] : two[i];\n"
+	  << "    } else {\n"
+	  << "      total += x_[e[i]] <= f[i] ? three[i] : four[i];\n"
+	  << "    }\n"
+	  << "  }\n"
+	  << "  return total;\n"
+	  << "}\n"
+	  << "\n"
+	  << "#endif\n";
+}
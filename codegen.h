@@ -0,0 +1,51 @@
+//
+// offline compilation of a depth-2 forest into c++
+//
+// for a fixed production model the split ids, thresholds and leaves are constants, yet rf_eval_soa loads
+// them (and gathers through the ids) on every call.  compile_forest2_cpp writes the forest out as c++
+// source in which they are literals: each group of 8 trees becomes straight line avx2 code
+//
+// xa = _mm256_i32gather_ps(x_, _mm256_setr_epi32(17, 3, ...), 4)
+// m1 = _mm256_cmp_ps(xa, _mm256_setr_ps(0x1.2p-4f, ...), _CMP_NLE_UQ)
+// ...
+//
+// ie rf_sum_soa_avx2 with every operand a rip-relative constant the compiler can see, and nothing left
+// of the loop or the pointer arithmetic.  it adds the groups up in the same order, so the generated sum
+// is bit for bit what rf_sum_soa_avx2 returns.  the avx-512, neon and sve kernels rf_sum_soa dispatches
+// to on other cpus add in other orders and agree with it only to rounding.  built without avx2 the same
+// file falls back to a loop over constexpr copies of the arrays, which adds the trees up in order (in
+// double, like the reference sums of check.h)
+//
+// make check holds both versions, generated for the fixed forest of check_forest.h, to those results
+//
+// the output is a header declaring
+//
+// constexpr size_t <name>_size            the number of trees
+// double <name>_sum(const float *x_)      the sum of the tree predictions, as rf_sum_soa_avx2 adds it
+// double <name>_eval(const float *x_)     <name>_sum / <name>_size
+//
+// and a source file to compile into the program.  the code is split into functions of groups_ groups so
+// the compiler isn't handed one function the size of the model.  it's still about 480 bytes of code and
+// constants per 8 trees, against 320 bytes of arrays, so a big model is a big (and slow to compile)
+// object whose instructions come in through the caches like the arrays did.  on the vm the README numbers
+// come from the compiled forest is about as fast as rf_eval_soa, not faster
+//
+// forestc does this for a forest file (see forest_file.h)
+//
+
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+#include "forest_soa.h"
+
+// groups of 8 trees per generated function
+const size_t CODEGEN_GROUPS = 64;
+
+// write the header and source for f_ to header_ and source_.  name_ prefixes every generated symbol and
+// is how the source includes the header (name_.h).  throws std::invalid_argument if it isn't an identifier
+// or the forest is empty
+void compile_forest2_cpp(const forest2_soa_view &f_, const std::string &name_, std::ostream &header_,
+			 std::ostream &source_, size_t groups_ = CODEGEN_GROUPS);
@@ -0,0 +1,113 @@
+//
+// node/tree to packed layout conversion (see compile.h)
+//
+
+#include "compile.h"
+
+#include <algorithm>
+
+size_t validate_tree(const tree &t_, size_t num_preds_)
+{
+  if(t_.empty()) {
+    throw std::invalid_argument("empty tree");
+  }
+
+  auto fail = [](size_t nodeID_, const std::string &what_) {
+    throw std::invalid_argument("node " + std::to_string(nodeID_) + ": " + what_);
+  };
+
+  // depth first from the root with an explicit stack, so a degenerate chain can't blow the call stack
+  // (the scratch is kept between calls, so validating a whole forest doesn't allocate for every tree)
+  thread_local std::vector<bool> seen;
+  thread_local std::vector<std::pair<size_t, size_t>> stack; // (nodeID, depth)
+  seen.assign(t_.size(), false);
+  stack.assign(1, { 0, 0 });
+  size_t depth = 0;
+  size_t visited = 0;
+  seen[0] = true;
+
+  while(!stack.empty()) {
+    auto [nodeID, level] = stack.back();
+    stack.pop_back();
+    ++visited;
+
+    const node &tn = t_[nodeID];
+    if(tn.leftChildNodeID == 0 && tn.rightChildNodeID == 0) {
+      depth = std::max(depth, level);
+      continue;
+    }
+
+    // the root can never be a child, so a 0 here means a missing child rather than a leaf
+    if(tn.leftChildNodeID == 0 || tn.rightChildNodeID == 0) {
+      fail(nodeID, "only one child");
+    }
+    if(num_preds_ != 0 && tn.splitVarID >= num_preds_) {
+      fail(nodeID, "split on predictor " + std::to_string(tn.splitVarID) + " out of range");
+    }
+    if(tn.splitVarID > UINT32_MAX) {
+      fail(nodeID, "split predictor does not fit in 32 bits");
+    }
+
+    for(uint64_t child : { tn.leftChildNodeID, tn.rightChildNodeID }) {
+      if(child >= t_.size()) {
+	fail(nodeID, "child " + std::to_string(child) + " out of range");
+      }
+      if(seen[child]) {
+	fail(nodeID, "child " + std::to_string(child) + " is already part of the tree (cycle or shared node)");
+      }
+      seen[child] = true;
+      stack.push_back({ child, level + 1 });
+    }
+  }
+
+  if(visited != t_.size()) {
+    fail(std::find(seen.begin(), seen.end(), false) - seen.begin(), "unreachable from the root");
+  }
+
+  return depth;
+}
+
+size_t forest_depth(const std::vector<tree> &f_, size_t num_preds_)
+{
+  size_t depth = 0;
+  for(const auto &t : f_) {
+    depth = std::max(depth, validate_tree(t, num_preds_));
+  }
+  return depth;
+}
+
+static tree2 to_tree2(const packed_tree<2> &p_)
+{
+  return { p_.splitVarID[0], p_.splitVarID[1], p_.splitVarID[2],
+	   p_.splitValue[0], p_.splitValue[1], p_.splitValue[2],
+	   p_.leaf[0], p_.leaf[1], p_.leaf[2], p_.leaf[3] };
+}
+
+tree2 pack_tree2(const tree &t_, size_t num_preds_)
+{
+  return to_tree2(pack_tree<2>(t_, num_preds_));
+}
+
+tree2 pack_valid_tree2(const tree &t_)
+{
+  return to_tree2(pack_valid_tree<2>(t_));
+}
+
+forest2 compile_forest2(const std::vector<tree> &f_, size_t num_preds_)
+{
+  forest2 out;
+  out.reserve(f_.size());
+  for(const auto &t : f_) {
+    out.push_back(pack_tree2(t, num_preds_));
+  }
+  return out;
+}
+
+forest2_soa compile_forest2_soa(const std::vector<tree> &f_, size_t num_preds_)
+{
+  forest2_soa out;
+  for(const auto &t : f_) {
+    out.push_back(pack_tree2(t, num_preds_));
+  }
+  return out;
+}
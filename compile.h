@@ -0,0 +1,97 @@
+//
+// converts traditional (ranger style) node/tree forests into the packed simd layouts
+//
+// the packed layouts all assume complete trees in heap order, so every tree is first validated and
+// then walked from the root, writing node n's children into heap positions 2n+1 and 2n+2.  a leaf that
+// sits above the target depth is padded out into a complete subtree whose leaves are all copies of it
+// (the padding splits are never relevant since both sides lead to the same value)
+//
+// any problem with a tree (bad child ids, cycles, shared or unreachable nodes, too deep) is reported by
+// throwing std::invalid_argument
+//
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "forest.h"
+#include "forest_soa.h"
+#include "simd_forest.h"
+
+// checks that t_ is a proper binary tree rooted at node 0 and returns its depth (0 for a lone leaf)
+// if num_preds_ is non-zero every split must also be on a predictor < num_preds_
+size_t validate_tree(const tree &t_, size_t num_preds_ = 0);
+
+// max depth over the forest, validating every tree
+size_t forest_depth(const std::vector<tree> &f_, size_t num_preds_ = 0);
+
+// writes the subtree of t_ at nodeID_ into heap position pos_ of a complete tree of depth Depth
+template<size_t Depth>
+void pack_subtree(const tree &t_, size_t nodeID_, size_t pos_, size_t level_, packed_tree<Depth> &out_)
+{
+  const node &tn = t_[nodeID_];
+  bool terminal = tn.leftChildNodeID == 0 && tn.rightChildNodeID == 0;
+
+  if(level_ == Depth) {
+    if(!terminal) {
+      throw std::invalid_argument("tree is deeper than " + std::to_string(Depth));
+    }
+    out_.leaf[pos_ - packed_tree<Depth>::NODES] = tn.splitValue;
+    return;
+  }
+
+  if(terminal) {
+    // pad with a dummy split, both children are this same leaf
+    out_.splitVarID[pos_] = 0;
+    out_.splitValue[pos_] = 0.0f;
+    pack_subtree<Depth>(t_, nodeID_, 2*pos_ + 1, level_ + 1, out_);
+    pack_subtree<Depth>(t_, nodeID_, 2*pos_ + 2, level_ + 1, out_);
+    return;
+  }
+
+  out_.splitVarID[pos_] = static_cast<uint32_t>(tn.splitVarID);
+  out_.splitValue[pos_] = tn.splitValue;
+  pack_subtree<Depth>(t_, tn.leftChildNodeID, 2*pos_ + 1, level_ + 1, out_);
+  pack_subtree<Depth>(t_, tn.rightChildNodeID, 2*pos_ + 2, level_ + 1, out_);
+}
+
+// pack a tree validate_tree has already accepted, of depth <= Depth, without validating it again
+template<size_t Depth>
+packed_tree<Depth> pack_valid_tree(const tree &t_)
+{
+  packed_tree<Depth> out;
+  pack_subtree<Depth>(t_, 0, 0, 0, out);
+  return out;
+}
+
+// pack a single tree of depth <= Depth
+template<size_t Depth>
+packed_tree<Depth> pack_tree(const tree &t_, size_t num_preds_ = 0)
+{
+  size_t depth = validate_tree(t_, num_preds_);
+  if(depth > Depth) {
+    throw std::invalid_argument("tree of depth " + std::to_string(depth) + " does not fit in depth " + std::to_string(Depth));
+  }
+  return pack_valid_tree<Depth>(t_);
+}
+
+template<size_t Depth>
+simd_forest<Depth> compile_forest(const std::vector<tree> &f_, size_t num_preds_ = 0)
+{
+  simd_forest<Depth> out;
+  for(const auto &t : f_) {
+    out.push_back(pack_tree<Depth>(t, num_preds_));
+  }
+  return out;
+}
+
+// the depth-2 layouts
+tree2 pack_tree2(const tree &t_, size_t num_preds_ = 0);
+tree2 pack_valid_tree2(const tree &t_);
+
+forest2 compile_forest2(const std::vector<tree> &f_, size_t num_preds_ = 0);
+
+forest2_soa compile_forest2_soa(const std::vector<tree> &f_, size_t num_preds_ = 0);
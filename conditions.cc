@@ -0,0 +1,119 @@
+//
+// shared split conditions (see conditions.h)
+//
+
+#include "conditions.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "simd.h"
+
+condition_forest::condition_forest(const forest2_soa &f_, size_t num_preds_)
+  : bins(f_, num_preds_), offset(num_preds_ + 1, 0), size(f_.size)
+{
+  for(size_t f = 0 ; f < num_preds_ ; ++f) {
+    offset[f + 1] = offset[f] + bins.cuts[f].size();
+  }
+
+  // the padding trees point at the spare word past the last condition, which is always 0
+  const uint32_t spare = (words() - 1) * 32;
+  size_t padded = f_.one.size();
+  root.assign(padded, spare);
+  left.assign(padded, spare);
+  right.assign(padded, spare);
+  one.assign(padded, 0.0f);
+  two.assign(padded, 0.0f);
+  three.assign(padded, 0.0f);
+  four.assign(padded, 0.0f);
+
+  // the cut index of a split value, which is always exact here since bins came from f_
+  auto id = [&](uint32_t f_id_, float v_) {
+    return offset[f_id_] + bins.bin(f_id_, v_);
+  };
+  for(size_t i = 0 ; i < size ; ++i) {
+    root[i] = id(f_.a_splitVarID[i], f_.b_splitValue[i]);
+    left[i] = id(f_.c_splitVarID[i], f_.d_splitValue[i]);
+    right[i] = id(f_.e_splitVarID[i], f_.f_splitValue[i]);
+    one[i] = f_.one[i];
+    two[i] = f_.two[i];
+    three[i] = f_.three[i];
+    four[i] = f_.four[i];
+  }
+}
+
+// set bits [lo_, hi_)
+static void set_bits(uint32_t *bits_, size_t lo_, size_t hi_)
+{
+  if(lo_ >= hi_) {
+    return;
+  }
+  size_t lw = lo_ / 32, hw = (hi_ - 1) / 32;
+  uint32_t lmask = ~0u << (lo_ % 32), hmask = ~0u >> (31 - (hi_ - 1) % 32);
+  if(lw == hw) {
+    bits_[lw] |= lmask & hmask;
+    return;
+  }
+  bits_[lw] |= lmask;
+  std::fill(bits_ + lw + 1, bits_ + hw, ~0u);
+  bits_[hw] |= hmask;
+}
+
+void condition_forest::evaluate(const float *x_, uint32_t *bits_) const
+{
+  memset(bits_, 0, words() * sizeof(uint32_t));
+  for(size_t f = 0 ; f < bins.num_preds() ; ++f) {
+    set_bits(bits_, offset[f], offset[f] + bins.bin(f, x_[f]));
+  }
+}
+
+#if defined(__x86_64__)
+
+// bit id_ of bits_ in every lane, as a blend mask
+static inline __m256 test_bits(const uint32_t *bits_, const uint32_t *id_)
+{
+  __m256i id = _mm256_load_si256((const __m256i *)id_);
+  __m256i w = _mm256_i32gather_epi32((const int *)bits_, _mm256_srli_epi32(id, 5), 4);
+  // move the bit up to the sign bit, which is all blendv looks at
+  return _mm256_castsi256_ps(_mm256_sllv_epi32(w, _mm256_sub_epi32(_mm256_set1_epi32(31), _mm256_and_si256(id, _mm256_set1_epi32(31)))));
+}
+
+double rf_sum_conditions(const condition_forest &f_, const uint32_t *bits_)
+{
+  __m256d tot = _mm256_setzero_pd();
+  for(size_t i = 0 ; i < f_.root.size() ; i += 8) {
+    __m256 r = test_bits(bits_, &f_.root[i]);
+    __m256 l = test_bits(bits_, &f_.left[i]);
+    __m256 h = test_bits(bits_, &f_.right[i]);
+
+    __m256 left = _mm256_blendv_ps(_mm256_load_ps(&f_.one[i]), _mm256_load_ps(&f_.two[i]), l);
+    __m256 right = _mm256_blendv_ps(_mm256_load_ps(&f_.three[i]), _mm256_load_ps(&f_.four[i]), h);
+    __m256 res = _mm256_blendv_ps(left, right, r);
+
+    tot = _mm256_add_pd(tot, _mm256_cvtps_pd(_mm256_castps256_ps128(res)));
+    tot = _mm256_add_pd(tot, _mm256_cvtps_pd(_mm256_extractf128_ps(res, 1)));
+  }
+  return horizontal_add(tot);
+}
+
+#else
+
+double rf_sum_conditions(const condition_forest &f_, const uint32_t *bits_)
+{
+  auto bit = [&](uint32_t id_) { return (bits_[id_ / 32] >> (id_ % 32)) & 1; };
+  double tot = 0.0;
+  for(size_t i = 0 ; i < f_.size ; ++i) {
+    if(bit(f_.root[i])) {
+      tot += bit(f_.right[i]) ? f_.four[i] : f_.three[i];
+    } else {
+      tot += bit(f_.left[i]) ? f_.two[i] : f_.one[i];
+    }
+  }
+  return tot;
+}
+
+#endif
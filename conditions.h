@@ -0,0 +1,48 @@
+//
+// shared split conditions, evaluated once per row into a bit vector (quickscorer style)
+//
+// a big forest over few features asks the same questions over and over: with 500k depth-2 trees on 256
+// features there are 1.5M splits but only as many distinct (feature, threshold) pairs as distinct split
+// values (see feature_bins in quantize.h).  so we number the distinct conditions, work out all of them for a
+// row up front, and each tree becomes three bit lookups and a leaf fetch
+//
+// working out the bits is cheap because the conditions on one feature are ordered: with the feature's cuts
+// sorted, "x > cuts[k]" holds exactly for k < bin(x), ie the bits of a feature are a prefix of ones.  so a
+// row costs one binary search and one run of set bits per feature
+//
+// bit set = the split goes right (x > threshold, or x is NaN), the same polarity as the simd masks
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "aligned.h"
+#include "forest_soa.h"
+#include "quantize.h"
+
+struct condition_forest {
+  feature_bins bins;
+  std::vector<uint32_t> offset;                    // first condition of each feature, offset[num_preds] = all of them
+  aligned_vector<uint32_t> root, left, right;      // condition ids per tree, padded to a multiple of 8 trees
+  aligned_vector<float> one, two, three, four;     // the leaves, as in forest2_soa
+  size_t size = 0;
+
+  condition_forest(const forest2_soa &f_, size_t num_preds_);
+
+  size_t conditions() const { return offset.back(); }
+  size_t words() const { return (conditions() + 31) / 32 + 1; }   // one spare word for the padding trees
+
+  // the condition bits of row x_ into bits_ (words() entries)
+  void evaluate(const float *x_, uint32_t *bits_) const;
+};
+
+// sum of the tree predictions given a row's condition bits
+double rf_sum_conditions(const condition_forest &f_, const uint32_t *bits_);
+
+inline double rf_eval_conditions(const condition_forest &f_, const uint32_t *bits_)
+{
+  return rf_sum_conditions(f_, bits_) / f_.size;
+}
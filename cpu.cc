@@ -0,0 +1,113 @@
+//
+// runtime cpu feature detection (see cpu.h)
+//
+
+#include "cpu.h"
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#elif defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_SVE
+#define HWCAP_SVE (1 << 22)
+#endif
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__)
+
+static uint64_t xgetbv0()
+{
+  uint32_t lo, hi;
+  __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+bool cpu_supports_avx512()
+{
+  unsigned int eax, ebx, ecx, edx;
+
+  // the os has to have enabled xsave before we can even ask it which register state it saves
+  if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE)) {
+    return false;
+  }
+  // xmm, ymm, opmask, zmm0-15 upper halves and zmm16-31 all saved on context switch
+  if((xgetbv0() & 0xe6) != 0xe6) {
+    return false;
+  }
+  if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return (ebx & bit_AVX512F) != 0;
+}
+
+bool cpu_supports_sve()
+{
+  return false;
+}
+
+#elif defined(__aarch64__)
+
+bool cpu_supports_avx512()
+{
+  return false;
+}
+
+bool cpu_supports_sve()
+{
+  return (getauxval(AT_HWCAP) & HWCAP_SVE) != 0;
+}
+
+#endif
+
+simd_isa selected_isa()
+{
+  static const simd_isa isa = []() {
+    const char *force = getenv("SPEEDSTUMPS_ISA");
+    bool baseline = force && (strcmp(force, "avx2") == 0 || strcmp(force, "neon") == 0);
+#if defined(__x86_64__)
+    return !baseline && cpu_supports_avx512() ? simd_isa::avx512 : simd_isa::avx2;
+#elif defined(__aarch64__)
+    return !baseline && cpu_supports_sve() ? simd_isa::sve : simd_isa::neon;
+#endif
+  }();
+  return isa;
+}
+
+static std::atomic<size_t> &prefetch_bytes()
+{
+  static std::atomic<size_t> bytes([]() {
+    const char *p = getenv("SPEEDSTUMPS_PREFETCH");
+    return p ? (size_t)strtoull(p, nullptr, 10) : (size_t)0;
+  }());
+  return bytes;
+}
+
+size_t prefetch_distance()
+{
+  return prefetch_bytes().load(std::memory_order_relaxed);
+}
+
+void set_prefetch_distance(size_t bytes_)
+{
+  prefetch_bytes().store(bytes_, std::memory_order_relaxed);
+}
+
+const char *isa_name(simd_isa isa_)
+{
+  switch(isa_) {
+  case simd_isa::avx2:
+    return "avx2";
+  case simd_isa::avx512:
+    return "avx512";
+  case simd_isa::neon:
+    return "neon";
+  case simd_isa::sve:
+    return "sve";
+  }
+  return "unknown";
+}
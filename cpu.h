@@ -0,0 +1,56 @@
+//
+// runtime cpu feature detection, for choosing between the kernels in kernels.h
+//
+// on x86 the whole library is built for avx2 and the avx-512 kernels live in their own translation unit
+// built with -mavx512f, on aarch64 the baseline is neon and the sve kernels get their own translation unit.
+// the public entry points (selectf, rf_sum_stumps, rf_sum_soa) pick one implementation the first time
+// they're called, so the same binary runs at full speed on machines with the wider isa and still runs on
+// ones without it
+//
+
+#pragma once
+
+#include <cstddef>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+enum class simd_isa { avx2, avx512, neon, sve };
+
+// does this cpu (and os, ie xsave enabled for the zmm state) support avx-512f?  straight from cpuid/xgetbv
+bool cpu_supports_avx512();
+
+// does this cpu support sve?  from the kernel's hwcaps
+bool cpu_supports_sve();
+
+// the isa the dispatching entry points use, decided once
+// setting SPEEDSTUMPS_ISA=avx2 (or neon on arm) in the environment forces the baseline kernels (eg for benchmarking)
+simd_isa selected_isa();
+
+const char *isa_name(simd_isa isa_);
+
+// how far ahead (in bytes of each array) the streaming avx2 kernels prefetch, 0 for not at all
+// starts from SPEEDSTUMPS_PREFETCH (default 0, ie leave it to the hardware prefetcher), read once per call
+size_t prefetch_distance();
+void set_prefetch_distance(size_t bytes_);
+
+// bring the cache line at p_ into l1 (a hint, never faults, so it may point past the end of an array)
+inline void prefetch(const void *p_)
+{
+#if defined(__x86_64__)
+  _mm_prefetch((const char *)p_, _MM_HINT_T0);
+#else
+  __builtin_prefetch(p_);
+#endif
+}
+
+// spin loop hint
+inline void cpu_relax()
+{
+#if defined(__x86_64__)
+  _mm_pause();
+#elif defined(__aarch64__)
+  __asm__ volatile("yield");
+#endif
+}
@@ -0,0 +1,59 @@
+//
+// mixed-shape forest engine (see engine.h)
+//
+
+#include "engine.h"
+
+#include "compile.h"
+
+forest_engine::forest_engine(const std::vector<tree> &f_, size_t num_preds_)
+{
+  for(const auto &t : f_) {
+    push_back(t, num_preds_);
+  }
+}
+
+void forest_engine::push_back(const tree &t_, size_t num_preds_)
+{
+  // validated once here, the buckets take it as it is
+  size_t depth = validate_tree(t_, num_preds_);
+  switch(depth) {
+  case 0:
+    constant += t_[0].splitValue;
+    break;
+  case 1: {
+    packed_tree<1> p = pack_valid_tree<1>(t_);
+    stumps.push_back(p.splitVarID[0], p.splitValue[0], p.leaf[0], p.leaf[1]);
+    break;
+  }
+  case 2:
+    depth2.push_back(pack_valid_tree2(t_));
+    break;
+  case 3:
+    std::get<simd_forest<3>>(packed).push_back(pack_valid_tree<3>(t_));
+    break;
+  case 4:
+    std::get<simd_forest<4>>(packed).push_back(pack_valid_tree<4>(t_));
+    break;
+  case 5:
+    std::get<simd_forest<5>>(packed).push_back(pack_valid_tree<5>(t_));
+    break;
+  case 6:
+    std::get<simd_forest<6>>(packed).push_back(pack_valid_tree<6>(t_));
+    break;
+  default:
+    deep.push_back(t_, depth);
+    break;
+  }
+  ++size;
+}
+
+double rf_sum_engine(const forest_engine &f_, const float *x_)
+{
+  double total = f_.constant;
+  total += rf_sum_stumps(f_.stumps, x_);
+  total += rf_sum_soa(f_.depth2.view(), x_);
+  std::apply([&](const auto &... p_) { ((total += rf_sum_simd(p_, x_)), ...); }, f_.packed);
+  total += rf_sum_flat(f_.deep, x_);
+  return total;
+}
@@ -0,0 +1,53 @@
+//
+// evaluation engine for forests of mixed shapes
+//
+// the simd kernels each want trees of one shape, but a real forest mixes depths.  the engine buckets
+// every tree by its actual depth and sends each bucket through the best kernel for it:
+//
+// depth 0     : a lone leaf, folded into a constant
+// depth 1     : stump_forest (the selectf kernel, with a gather for the features)
+// depth 2     : forest2_soa
+// depth 3..6  : simd_forest<Depth>
+// deeper      : flat_forest (branchless scalar traversal)
+//
+// the result is the sum over all trees divided by the number of trees, like rf_eval, but not in rf_eval's
+// order: every bucket's kernel sums its trees in double lanes and the bucket totals are added after, so
+// the two agree up to rounding of the double sums, the bound check.h holds the engine to
+//
+
+#pragma once
+
+#include <tuple>
+#include <vector>
+
+#include "flat_forest.h"
+#include "forest.h"
+#include "forest_soa.h"
+#include "simd_forest.h"
+#include "stumps.h"
+
+// deepest trees that still get a simd_forest bucket
+const size_t ENGINE_MAX_PACKED_DEPTH = 6;
+
+struct forest_engine {
+  double constant = 0.0;
+  stump_forest stumps;
+  forest2_soa depth2;
+  std::tuple<simd_forest<3>, simd_forest<4>, simd_forest<5>, simd_forest<6>> packed;
+  flat_forest deep;
+  size_t size = 0;      // total number of trees
+
+  forest_engine() = default;
+  explicit forest_engine(const std::vector<tree> &f_, size_t num_preds_ = 0);
+
+  // validates t_ (see compile.h) and adds it to the bucket for its depth
+  void push_back(const tree &t_, size_t num_preds_ = 0);
+};
+
+// sum of the tree predictions for sample x_
+double rf_sum_engine(const forest_engine &f_, const float *x_);
+
+inline double rf_eval_engine(const forest_engine &f_, const std::vector<float> &x_)
+{
+  return rf_sum_engine(f_, &x_[0]) / f_.size;
+}
@@ -0,0 +1,74 @@
+//
+// flat forest storage and branchless scalar traversal (see flat_forest.h)
+//
+
+#include "flat_forest.h"
+
+#include <stdexcept>
+
+#include "compile.h"
+
+flat_forest::flat_forest(const std::vector<tree> &f_)
+{
+  std::vector<size_t> depths;
+  depths.reserve(f_.size());
+  size_t total = 0;
+  for(const tree &t : f_) {
+    depths.push_back(validate_tree(t));
+    total += t.size() + 1;
+  }
+  if(total > UINT32_MAX) {
+    throw std::invalid_argument("flat_forest is limited to 2^32 nodes");
+  }
+
+  nodes.reserve(total);
+  for(size_t i = 0 ; i < f_.size() ; ++i) {
+    append(f_[i], depths[i]);
+  }
+}
+
+void flat_forest::push_back(const tree &t_)
+{
+  push_back(t_, validate_tree(t_));
+}
+
+void flat_forest::push_back(const tree &t_, size_t depth_)
+{
+  if(nodes.size() + t_.size() + 1 > UINT32_MAX) {
+    throw std::invalid_argument("flat_forest is limited to 2^32 nodes");
+  }
+  append(t_, depth_);
+}
+
+void flat_forest::append(const tree &t_, size_t depth_)
+{
+  size_t base = nodes.size() + 1;
+  nodes.push_back({ static_cast<uint32_t>(base + t_.size()), static_cast<uint32_t>(depth_), 0, 0.0f });
+
+  for(size_t i = 0 ; i < t_.size() ; ++i) {
+    const node &tn = t_[i];
+    uint32_t self = static_cast<uint32_t>(base + i);
+    if(tn.leftChildNodeID == 0 && tn.rightChildNodeID == 0) {
+      nodes.push_back({ self, self, 0, tn.splitValue });
+    } else {
+      nodes.push_back({ static_cast<uint32_t>(base + tn.leftChildNodeID), static_cast<uint32_t>(base + tn.rightChildNodeID),
+			static_cast<uint32_t>(tn.splitVarID), tn.splitValue });
+    }
+  }
+  ++count;
+}
+
+double rf_sum_flat(const flat_forest &f_, const float *x_)
+{
+  const flat_node *nodes = f_.nodes.data();
+  double total = 0.0;
+  for(size_t h = 0 ; h < f_.nodes.size() ; h = nodes[h].left) {
+    uint32_t n = static_cast<uint32_t>(h + 1);
+    for(uint32_t l = 0 ; l < nodes[h].right ; ++l) {
+      const flat_node &fn = nodes[n];
+      n = x_[fn.splitVarID] <= fn.splitValue ? fn.left : fn.right;
+    }
+    total += nodes[n].splitValue;
+  }
+  return total;
+}
@@ -0,0 +1,58 @@
+//
+// flat (single array) storage for trees of any shape
+//
+// this is the fallback for trees too deep to pad out to a complete simd_forest.  all the nodes of all the
+// trees live in one array with 32-bit absolute child indices, and leaves point back at themselves so that
+// a tree can be walked for exactly its depth without checking for terminal nodes:
+//
+// n = root
+// repeat depth times:
+//   n = x[n.splitVarID] <= n.splitValue ? n.left : n.right   // a cmov, not a branch
+// result = n.splitValue
+//
+// the forest is one arena: each tree is a header node followed by its nodes, so a whole model is a single
+// allocation (the vector<tree> it's built from is one per tree) and a pass over it only ever walks forward.
+// a header's left is the index of the next tree's header and its right the tree's depth, the root is the
+// node right after it.  a node is 16 bytes against 32 for a `node`, four to a cache line
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "aligned.h"
+#include "forest.h"
+
+struct flat_node {
+  uint32_t left, right;    // absolute indices into flat_forest::nodes, a leaf points at itself (headers: see above)
+  uint32_t splitVarID;
+  float splitValue;        // prediction for a leaf
+};
+
+struct flat_forest {
+  aligned_vector<flat_node> nodes;  // headers and tree nodes
+  size_t count = 0;
+
+  flat_forest() = default;
+  // validates every tree of f_ before allocating the arena once, at its final size
+  explicit flat_forest(const std::vector<tree> &f_);
+
+  size_t size() const { return count; }
+
+  // validates t_ (see compile.h) and appends it
+  void push_back(const tree &t_);
+  // appends t_, which validate_tree has already accepted with depth depth_
+  void push_back(const tree &t_, size_t depth_);
+
+private:
+  void append(const tree &t_, size_t depth_);
+};
+
+// sum of the tree predictions for sample x_
+double rf_sum_flat(const flat_forest &f_, const float *x_);
+
+inline double rf_eval_flat(const flat_forest &f_, const float *x_)
+{
+  return rf_sum_flat(f_, x_) / f_.size();
+}
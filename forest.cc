@@ -0,0 +1,126 @@
+//
+// random forest evaluation for trees of depth 2 (see forest.h for the simd layout)
+//
+
+#include "forest.h"
+
+#include <algorithm>
+
+#include "cpu.h"
+
+double tree_eval(const tree &t_, const std::vector<float> &x_)
+{
+  // For each sample start in root, drop down the tree and return final value
+  size_t nodeID = 0;
+  while (1) {
+    const auto &tn = t_[nodeID];
+    // Break if terminal node
+    if (tn.leftChildNodeID == 0 && tn.rightChildNodeID == 0) {
+      break;
+    }
+
+    // Move to child
+    double value = x_[tn.splitVarID];
+
+    if (value <= tn.splitValue) {
+      // Move to left child
+      nodeID = tn.leftChildNodeID;
+    } else {
+      // Move to right child
+      nodeID = tn.rightChildNodeID;
+    }
+  }
+
+  return t_[nodeID].splitValue;
+}
+
+double rf_eval(const std::vector<tree> &f_, const std::vector<float> &x_)
+{
+  double total = 0.0;
+  for(const auto &t : f_) {
+    total += tree_eval(t, x_);
+  }
+  return total / f_.size();
+}
+
+double rf_eval_simd(const forest2 &f_, const std::vector<float> &x_)
+{
+  double total = 0.0;
+  size_t count = f_.size() / 2;
+  const size_t pf = prefetch_distance() / sizeof(tree2);
+  for(size_t i = 0 ; i < count ; i++) {
+    if(pf) {
+      // a pair is 80 bytes, so it can touch two lines
+      prefetch(&f_[i*2] + pf);
+      prefetch((const char *)(&f_[i*2] + pf) + 64);
+    }
+    total += tree_eval_simd(f_[i*2 + 0], f_[i*2 + 1], x_);
+  }
+  return total / f_.size();;
+}
+
+#if defined(__x86_64__)
+
+double rf_eval_simd_gather(const forest2 &f_, const std::vector<float> &x_)
+{
+  // keep the per-pair sums in double lanes rather than reducing every pair like rf_eval_simd does
+  __m256d total = _mm256_setzero_pd();
+  size_t count = f_.size() / 2;
+  const size_t pf = prefetch_distance() / sizeof(tree2);
+  for(size_t i = 0 ; i < count ; i++) {
+    if(pf) {
+      // a pair is 80 bytes, so it can touch two lines
+      prefetch(&f_[i*2] + pf);
+      prefetch((const char *)(&f_[i*2] + pf) + 64);
+    }
+    total = _mm256_add_pd(total, _mm256_cvtps_pd(tree_eval_simd_gather(&f_[i*2], &x_[0])));
+  }
+  return horizontal_add(total) / f_.size();
+}
+
+#elif defined(__aarch64__)
+
+// neon has no gathers, so this is just the plain version
+double rf_eval_simd_gather(const forest2 &f_, const std::vector<float> &x_)
+{
+  return rf_eval_simd(f_, x_);
+}
+
+#endif
+
+template<typename ROW>
+static void rf_eval_simd_tiled(const forest2 &f_, size_t rows_, ROW row_, double *out, size_t tile_)
+{
+  size_t count = f_.size() / 2;
+  size_t tile = tile_ < 2 ? 1 : tile_ / 2; // in pairs of trees
+
+  for(size_t r = 0 ; r < rows_ ; ++r) {
+    out[r] = 0.0;
+  }
+
+  for(size_t start = 0 ; start < count ; start += tile) {
+    size_t end = std::min(start + tile, count);
+    for(size_t r = 0 ; r < rows_ ; ++r) {
+      auto xr = row_(r);
+      double total = out[r];
+      for(size_t i = start ; i < end ; i++) {
+	total += tree_eval_simd(f_[i*2 + 0], f_[i*2 + 1], xr);
+      }
+      out[r] = total;
+    }
+  }
+
+  for(size_t r = 0 ; r < rows_ ; ++r) {
+    out[r] /= f_.size();
+  }
+}
+
+void rf_eval_simd_batch(const forest2 &f_, const float *x_, size_t rows_, size_t num_preds_,
+			sample_layout layout_, double *out, size_t tile_)
+{
+  if(layout_ == sample_layout::row_major) {
+    rf_eval_simd_tiled(f_, rows_, [&](size_t r_) { return x_ + r_ * num_preds_; }, out, tile_);
+  } else {
+    rf_eval_simd_tiled(f_, rows_, [&](size_t r_) { return strided_row{x_ + r_, rows_}; }, out, tile_);
+  }
+}
@@ -0,0 +1,228 @@
+//
+// random forest evaluation, for trees of depth 2
+//
+// the idea is based on what the stump kernels do.  in this case it is a little more complex because things are 2-level
+//
+// similar to gpu programming we can imagine branches being "shut off" if they are not selected
+//
+// imagine we do a _mm256_cmp_ps, this gives us 8 floating point lanes
+// there are 4 possible outcomes from a 2-level decision tree
+// lets say the tree looks like this:
+/*
+         a <= b
+        /      \
+      c <= d  e <= f
+       /  \    /  \
+      1    2  3    4
+*/
+//
+// if we stack the comparisons vertically, we could do the following:
+//
+// aaaa
+//  <=
+// bbbb   (lanes 3 and 4 inverted)
+//  && 
+// ccee
+//  <=
+// ddff   (lanes 2 and 4 inverted)
+//
+// So, we have two sets of comparisons that generate masks, and at the end
+// we take the bitwise && of the two masks -- only one possibility will be 1.
+// (inverting rather than comparing bbaa <= aabb keeps ties and NaNs going the same way as tree_eval)
+//
+// Since we have 8 lanes and only use 4, this means we can evaluate two trees at once.
+//
+// This implies we should store the trees differently than the way they are usually stored.
+// It would be best to store a,b,c,d and 1,2,3,4 all in the same structure.
+//
+
+#pragma once
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include <cstdint>
+#include <vector>
+
+#include "aligned.h"
+#include "simd.h"
+
+// traditional (ranger style) tree storage
+// a node with no children is terminal and its splitValue is the prediction
+struct node
+{
+  uint64_t leftChildNodeID;
+  uint64_t rightChildNodeID;
+  uint64_t splitVarID;
+  float splitValue;              
+};
+
+typedef std::vector<node> tree;
+
+double tree_eval(const tree &t_, const std::vector<float> &x_);
+
+double rf_eval(const std::vector<tree> &f_, const std::vector<float> &x_);
+
+// pack entire tree into structure for the SIMD version
+struct tree2 {
+  uint32_t a_splitVarID, c_splitVarID, e_splitVarID;
+  float b_splitValue, d_splitValue, f_splitValue;
+  float one, two, three, four;
+};
+
+// a depth-2 forest, in the same aligned (and when big enough huge page backed, see aligned.h) storage as
+// the soa arrays
+typedef aligned_vector<tree2> forest2;
+
+#if defined(__x86_64__)
+
+// X is anything indexable by split variable: a std::vector<float>, a raw row pointer, or a strided_row
+template<typename X>
+inline double tree_eval_simd(const tree2 &t1_, const tree2 &t2_, const X &x_)
+{
+  __m256 cmp1 = _mm256_set_ps(x_[t1_.a_splitVarID],
+			      x_[t1_.a_splitVarID],
+			      x_[t1_.a_splitVarID],
+			      x_[t1_.a_splitVarID],
+			      x_[t2_.a_splitVarID],
+			      x_[t2_.a_splitVarID],
+			      x_[t2_.a_splitVarID],
+			      x_[t2_.a_splitVarID]);
+  __m256 cmp2 = _mm256_set_ps(t1_.b_splitValue,
+			      t1_.b_splitValue,
+			      t1_.b_splitValue,
+			      t1_.b_splitValue,
+			      t2_.b_splitValue,
+			      t2_.b_splitValue,
+			      t2_.b_splitValue,
+			      t2_.b_splitValue);
+  // x <= b in every lane, inverted in the lanes of three and four, so a lane is set when the root sends the
+  // sample towards its leaf (and a NaN, failing every <=, goes right)
+  __m256 cmpres1 = _mm256_cmp_ps(cmp1, cmp2, 18); // <=
+  cmpres1 = _mm256_xor_ps(cmpres1, _mm256_castsi256_ps(_mm256_set_epi32(0, 0, -1, -1, 0, 0, -1, -1)));
+
+  cmp1 = _mm256_set_ps(x_[t1_.c_splitVarID],
+		       x_[t1_.c_splitVarID],
+		       x_[t1_.e_splitVarID],
+		       x_[t1_.e_splitVarID],
+		       x_[t2_.c_splitVarID],
+		       x_[t2_.c_splitVarID],
+		       x_[t2_.e_splitVarID],
+		       x_[t2_.e_splitVarID]);
+  cmp2 = _mm256_set_ps(t1_.d_splitValue,
+		       t1_.d_splitValue,
+		       t1_.f_splitValue,
+		       t1_.f_splitValue,
+		       t2_.d_splitValue,
+		       t2_.d_splitValue,
+		       t2_.f_splitValue,
+		       t2_.f_splitValue);
+
+  // the same for the children, inverted in the lanes of two and four
+  __m256 cmpres2 = _mm256_cmp_ps(cmp1, cmp2, 18); // <=
+  cmpres2 = _mm256_xor_ps(cmpres2, _mm256_castsi256_ps(_mm256_set_epi32(0, -1, 0, -1, 0, -1, 0, -1)));
+
+  __m256i mask = _mm256_and_si256((__m256i)cmpres1, (__m256i)cmpres2);
+  __m256 res1 = _mm256_set_ps(t1_.one, t1_.two, t1_.three, t1_.four,
+			     t2_.one, t2_.two, t2_.three, t2_.four);
+  __m256 res2 = _mm256_setzero_ps();
+  _mm256_maskstore_ps((float *)(&res2), mask, res1);
+  
+  return horizontal_add(res2); // note: the SUM of the two trees!
+}
+
+// gather based version of tree_eval_simd for t_[0] and t_[1], with the features in a contiguous row
+//
+// instead of assembling each operand from scalars, the split ids are loaded straight out of the two
+// tree2's and used as gather indices, and the comparison operands are built with in-lane shuffles
+//
+// the lanes of each 128-bit half hold one tree's leaves (one, two, three, four), so:
+//
+// level 1: aaaa <= bbbb, with the right hand leaves (three, four) inverted
+// level 2: ccee <= ddff, with the right hand leaves (two, four) inverted
+//
+// inverting the mask (rather than comparing the other way round) keeps ties and NaNs going the same
+// way as tree_eval.  the sum of the two trees is left in the low 128 bits of the result
+inline __m128 tree_eval_simd_gather(const tree2 *t_, const float *x_)
+{
+  const float *p = (const float *)t_;
+  const float *q = (const float *)(t_ + 1);
+
+  // [a c e b] for each tree, the b lanes are masked off so they are never used as an index
+  __m256i ids = _mm256_setr_m128i(_mm_loadu_si128((const __m128i *)p), _mm_loadu_si128((const __m128i *)q));
+  __m256 idmask = _mm256_castsi256_ps(_mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0));
+  __m256 feat = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), x_, ids, idmask, 4);
+
+  // [b d f one] and [one two three four] for each tree
+  __m256 split = _mm256_setr_m128(_mm_loadu_ps(p + 3), _mm_loadu_ps(q + 3));
+  __m256 leaves = _mm256_setr_m128(_mm_loadu_ps(p + 6), _mm_loadu_ps(q + 6));
+
+  __m256 cmpres1 = _mm256_cmp_ps(_mm256_permute_ps(feat, _MM_SHUFFLE(0, 0, 0, 0)),
+				 _mm256_permute_ps(split, _MM_SHUFFLE(0, 0, 0, 0)), 18); // <=
+  __m256 cmpres2 = _mm256_cmp_ps(_mm256_permute_ps(feat, _MM_SHUFFLE(2, 2, 1, 1)),
+				 _mm256_permute_ps(split, _MM_SHUFFLE(2, 2, 1, 1)), 18); // <=
+  cmpres1 = _mm256_xor_ps(cmpres1, _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, -1, -1, 0, 0, -1, -1)));
+  cmpres2 = _mm256_xor_ps(cmpres2, _mm256_castsi256_ps(_mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1)));
+
+  __m256 res = _mm256_and_ps(_mm256_and_ps(cmpres1, cmpres2), leaves);
+  return _mm_add_ps(_mm256_castps256_ps128(res), _mm256_extractf128_ps(res, 1));
+}
+
+#elif defined(__aarch64__)
+
+// neon version of a single tree: 128 bits only fit one tree's 4 leaves, so the stacked comparisons are
+// done the tree_eval_simd_gather way below (one comparison per level, right hand lanes inverted)
+template<typename X>
+inline float tree_eval_neon(const tree2 &t_, const X &x_)
+{
+  const uint32x4_t flip1 = { 0, 0, 0xffffffff, 0xffffffff };
+  const uint32x4_t flip2 = { 0, 0xffffffff, 0, 0xffffffff };
+
+  uint32x4_t cmpres1 = vcleq_f32(vdupq_n_f32(x_[t_.a_splitVarID]), vdupq_n_f32(t_.b_splitValue));
+  uint32x4_t cmpres2 = vcleq_f32(vcombine_f32(vdup_n_f32(x_[t_.c_splitVarID]), vdup_n_f32(x_[t_.e_splitVarID])),
+				 vcombine_f32(vdup_n_f32(t_.d_splitValue), vdup_n_f32(t_.f_splitValue)));
+  uint32x4_t mask = vandq_u32(veorq_u32(cmpres1, flip1), veorq_u32(cmpres2, flip2));
+
+  float32x4_t leaves = vld1q_f32(&t_.one);
+  return vaddvq_f32(vreinterpretq_f32_u32(vandq_u32(mask, vreinterpretq_u32_f32(leaves))));
+}
+
+// X is anything indexable by split variable: a std::vector<float>, a raw row pointer, or a strided_row
+template<typename X>
+inline double tree_eval_simd(const tree2 &t1_, const tree2 &t2_, const X &x_)
+{
+  return tree_eval_neon(t1_, x_) + tree_eval_neon(t2_, x_); // note: the SUM of the two trees, in float like the avx version
+}
+
+#endif
+
+// evaluates the trees two at a time, so f_ should hold an even number of trees
+double rf_eval_simd(const forest2 &f_, const std::vector<float> &x_);
+
+// same as rf_eval_simd but using tree_eval_simd_gather, x_ must hold every predictor the forest splits on
+double rf_eval_simd_gather(const forest2 &f_, const std::vector<float> &x_);
+
+// how a batch of samples is laid out in memory
+// row_major: sample r is x_[r * num_preds_ .. (r + 1) * num_preds_)
+// col_major: predictor j of sample r is x_[j * rows_ + r]
+enum class sample_layout { row_major, col_major };
+
+// one sample out of a column-major batch
+struct strided_row {
+  const float *p;
+  size_t stride;
+  float operator[](size_t j_) const { return p[j_ * stride]; }
+};
+
+// default number of trees per cache block, 512 tree2's are 20KB which stays resident in L1
+const size_t RF_BATCH_TILE = 512;
+
+// evaluate rows_ samples against f_, writing rf_eval_simd's result for each sample to out
+//
+// the forest is walked in tiles of tile_ trees and every row is scored against a tile before moving
+// on to the next one, so each tile is read from memory once per batch instead of once per row
+void rf_eval_simd_batch(const forest2 &f_, const float *x_, size_t rows_, size_t num_preds_,
+			sample_layout layout_, double *out, size_t tile_ = RF_BATCH_TILE);
@@ -0,0 +1,133 @@
+//
+// forest file save and mmap load (see forest_file.h)
+//
+
+#include "forest_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static const char FOREST_FILE_MAGIC[8] = {'S', 'S', 'F', 'O', 'R', 'E', 'S', 'T'};
+static const uint32_t FOREST_FILE_BYTE_ORDER = 0x01020304;
+static const uint32_t FOREST_FILE_KIND_SOA2 = 2;
+static const uint32_t FOREST_FILE_SOA2_ARRAYS = 10;
+
+static uint64_t array_stride(uint64_t padded_size_)
+{
+  return (padded_size_ * 4 + 63) & ~(uint64_t)63;
+}
+
+void save_forest2_soa(const forest2_soa &f_, const std::string &path_, size_t num_preds_)
+{
+  forest_file_header h = {};
+  memcpy(h.magic, FOREST_FILE_MAGIC, sizeof(h.magic));
+  h.version = FOREST_FILE_VERSION;
+  h.byte_order = FOREST_FILE_BYTE_ORDER;
+  h.kind = FOREST_FILE_KIND_SOA2;
+  h.array_count = FOREST_FILE_SOA2_ARRAYS;
+  h.size = f_.size;
+  h.padded_size = f_.one.size();
+  h.array_stride = array_stride(h.padded_size);
+  h.num_preds = num_preds_;
+
+  std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+  if(!out) {
+    throw std::runtime_error("can't write " + path_);
+  }
+  out.write((const char *)&h, sizeof(h));
+
+  const std::vector<char> fill(h.array_stride - h.padded_size * 4, 0);
+  auto write = [&](const void *p_) {
+    out.write((const char *)p_, h.padded_size * 4);
+    out.write(fill.data(), fill.size());
+  };
+  write(f_.a_splitVarID.data());
+  write(f_.c_splitVarID.data());
+  write(f_.e_splitVarID.data());
+  write(f_.b_splitValue.data());
+  write(f_.d_splitValue.data());
+  write(f_.f_splitValue.data());
+  write(f_.one.data());
+  write(f_.two.data());
+  write(f_.three.data());
+  write(f_.four.data());
+
+  if(!out.flush()) {
+    throw std::runtime_error("error writing " + path_);
+  }
+}
+
+mapped_forest2_soa::mapped_forest2_soa(const std::string &path_)
+{
+  int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd < 0) {
+    throw std::runtime_error("can't open " + path_ + ": " + strerror(errno));
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(forest_file_header)) {
+    close(fd);
+    throw std::runtime_error(path_ + ": not a forest file (too short)");
+  }
+  length = st.st_size;
+  data = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd); // the mapping keeps the file alive
+  if(data == MAP_FAILED) {
+    throw std::runtime_error("can't map " + path_ + ": " + strerror(errno));
+  }
+
+  const forest_file_header &h = header();
+  const char *problem = nullptr;
+  if(memcmp(h.magic, FOREST_FILE_MAGIC, sizeof(h.magic)) != 0) {
+    problem = "not a forest file";
+  } else if(h.byte_order != FOREST_FILE_BYTE_ORDER) {
+    problem = "written with the other byte order";
+  } else if(h.version != FOREST_FILE_VERSION) {
+    problem = "unsupported version";
+  } else if(h.kind != FOREST_FILE_KIND_SOA2 || h.array_count != FOREST_FILE_SOA2_ARRAYS) {
+    problem = "not a depth-2 soa forest";
+  } else if(h.padded_size % 8 != 0 || h.size > h.padded_size || h.padded_size > (UINT64_MAX - 63) / 4
+	    || h.array_stride != array_stride(h.padded_size)) {
+    problem = "inconsistent header";
+  } else if(h.array_stride > (UINT64_MAX - sizeof(h)) / h.array_count
+	    || length < sizeof(h) + h.array_count * h.array_stride) {
+    problem = "truncated";
+  }
+  if(problem) {
+    munmap(data, length);
+    throw std::runtime_error(path_ + ": " + problem);
+  }
+
+  const char *base = (const char *)data + sizeof(h);
+  auto array = [&](size_t i_) { return base + i_ * h.array_stride; };
+  v = { (const uint32_t *)array(0), (const uint32_t *)array(1), (const uint32_t *)array(2),
+	(const float *)array(3), (const float *)array(4), (const float *)array(5),
+	(const float *)array(6), (const float *)array(7), (const float *)array(8), (const float *)array(9),
+	h.size, h.padded_size };
+
+  // the kernels index the sample with these unchecked, padding included
+  if(h.num_preds != 0) {
+    for(const uint32_t *ids : { v.a_splitVarID, v.c_splitVarID, v.e_splitVarID }) {
+      for(size_t i = 0 ; i < h.padded_size ; ++i) {
+	if(ids[i] >= h.num_preds) {
+	  const std::string why = "split on predictor " + std::to_string(ids[i]) + " of " + std::to_string(h.num_preds);
+	  munmap(data, length);
+	  throw std::runtime_error(path_ + ": " + why);
+	}
+      }
+    }
+  }
+}
+
+mapped_forest2_soa::~mapped_forest2_soa()
+{
+  munmap(data, length);
+}
@@ -0,0 +1,68 @@
+//
+// on-disk format for soa depth-2 forests, scored straight out of a read-only mmap
+//
+// the file is the forest2_soa arrays as they are in memory, each starting on a 64-byte boundary, behind a
+// 64-byte header:
+//
+// offset 0     : forest_file_header
+// offset 64    : a_splitVarID[padded_size], then zero fill to the next multiple of 64
+//                c_splitVarID, e_splitVarID, b_splitValue, d_splitValue, f_splitValue, one, two, three, four
+//                (the same way, in that order)
+//
+// all values are little endian 32-bit, ie native on the machines we run on, so loading is an mmap and a
+// header check: nothing is parsed or copied, the page cache is shared between every process mapping the
+// same file, and pages are only faulted in as the kernels touch them
+//
+// a malformed file (bad magic, other version or byte order, truncated) throws std::runtime_error, as does
+// one recording num_preds with a split id that isn't below it.  checking that reads the three id arrays
+// once at load, a file with num_preds 0 skips it and the ids are trusted
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "forest_soa.h"
+
+const uint32_t FOREST_FILE_VERSION = 1;
+
+struct forest_file_header {
+  char magic[8];          // "SSFOREST"
+  uint32_t version;       // FOREST_FILE_VERSION
+  uint32_t byte_order;    // 0x01020304 as written by the saving machine
+  uint32_t kind;          // 2 = forest2_soa (the only kind so far)
+  uint32_t array_count;   // number of arrays after the header
+  uint64_t size;          // number of real trees
+  uint64_t padded_size;   // entries in every array
+  uint64_t array_stride;  // bytes from one array to the next, a multiple of 64
+  uint64_t num_preds;     // predictors the forest was built for, 0 if unknown
+  uint8_t reserved[8];
+};
+
+static_assert(sizeof(forest_file_header) == 64);
+
+// writes f_ to path_ (num_preds_ is just recorded for whoever loads it)
+void save_forest2_soa(const forest2_soa &f_, const std::string &path_, size_t num_preds_ = 0);
+
+// a forest file mapped read-only, valid until destroyed
+class mapped_forest2_soa {
+public:
+  explicit mapped_forest2_soa(const std::string &path_);
+  ~mapped_forest2_soa();
+
+  mapped_forest2_soa(const mapped_forest2_soa &) = delete;
+  mapped_forest2_soa &operator=(const mapped_forest2_soa &) = delete;
+
+  const forest_file_header &header() const { return *(const forest_file_header *)data; }
+  size_t num_preds() const { return header().num_preds; }
+
+  // for rf_sum_soa/rf_eval_soa, pointing into the mapping
+  forest2_soa_view view() const { return v; }
+
+private:
+  void *data;
+  size_t length;
+  forest2_soa_view v;
+};
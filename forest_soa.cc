@@ -0,0 +1,128 @@
+//
+// structure-of-arrays depth-2 forest (see forest_soa.h)
+//
+
+#include "forest_soa.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "cpu.h"
+#include "kernels.h"
+
+forest2_soa::forest2_soa(const forest2 &f_)
+{
+  for(const auto &t : f_) {
+    push_back(t);
+  }
+}
+
+void forest2_soa::push_back(const tree2 &t_)
+{
+  // overwrite the padding tree in the current group of 8 if there is one
+  if(size == one.size()) {
+    for(size_t i = 0 ; i < 8 ; ++i) {
+      a_splitVarID.push_back(0);
+      c_splitVarID.push_back(0);
+      e_splitVarID.push_back(0);
+      b_splitValue.push_back(0.0f);
+      d_splitValue.push_back(0.0f);
+      f_splitValue.push_back(0.0f);
+      one.push_back(0.0f);
+      two.push_back(0.0f);
+      three.push_back(0.0f);
+      four.push_back(0.0f);
+    }
+  }
+
+  a_splitVarID[size] = t_.a_splitVarID;
+  c_splitVarID[size] = t_.c_splitVarID;
+  e_splitVarID[size] = t_.e_splitVarID;
+  b_splitValue[size] = t_.b_splitValue;
+  d_splitValue[size] = t_.d_splitValue;
+  f_splitValue[size] = t_.f_splitValue;
+  one[size] = t_.one;
+  two[size] = t_.two;
+  three[size] = t_.three;
+  four[size] = t_.four;
+  ++size;
+}
+
+forest2_soa_view forest2_soa::view() const
+{
+  return { a_splitVarID.data(), c_splitVarID.data(), e_splitVarID.data(),
+	   b_splitValue.data(), d_splitValue.data(), f_splitValue.data(),
+	   one.data(), two.data(), three.data(), four.data(),
+	   size, one.size() };
+}
+
+#if defined(__x86_64__)
+
+double rf_sum_soa_avx2(const forest2_soa_view &f_, const float *x_)
+{
+  __m256d total_lo = _mm256_setzero_pd();
+  __m256d total_hi = _mm256_setzero_pd();
+
+  const size_t pf = prefetch_distance() / sizeof(float);
+  for(size_t i = 0 ; i < f_.padded_size ; i += 8) {
+    if(pf) {
+      // ten streams, each one line per iteration
+      prefetch(f_.a_splitVarID + i + pf);
+      prefetch(f_.c_splitVarID + i + pf);
+      prefetch(f_.e_splitVarID + i + pf);
+      prefetch(f_.b_splitValue + i + pf);
+      prefetch(f_.d_splitValue + i + pf);
+      prefetch(f_.f_splitValue + i + pf);
+      prefetch(f_.one + i + pf);
+      prefetch(f_.two + i + pf);
+      prefetch(f_.three + i + pf);
+      prefetch(f_.four + i + pf);
+    }
+    __m256 xa = _mm256_i32gather_ps(x_, _mm256_load_si256((const __m256i *)(f_.a_splitVarID + i)), 4);
+    __m256 xc = _mm256_i32gather_ps(x_, _mm256_load_si256((const __m256i *)(f_.c_splitVarID + i)), 4);
+    __m256 xe = _mm256_i32gather_ps(x_, _mm256_load_si256((const __m256i *)(f_.e_splitVarID + i)), 4);
+
+    // note: the compares are !(<=) so that a set mask bit selects the right hand side
+    // (_CMP_NLE_UQ rather than _CMP_GT_OQ so that a NaN feature goes right, like in tree_eval)
+    __m256 m1 = _mm256_cmp_ps(xa, _mm256_load_ps(f_.b_splitValue + i), _CMP_NLE_UQ);
+    __m256 m2 = _mm256_cmp_ps(xc, _mm256_load_ps(f_.d_splitValue + i), _CMP_NLE_UQ);
+    __m256 m3 = _mm256_cmp_ps(xe, _mm256_load_ps(f_.f_splitValue + i), _CMP_NLE_UQ);
+
+    __m256 left = _mm256_blendv_ps(_mm256_load_ps(f_.one + i), _mm256_load_ps(f_.two + i), m2);
+    __m256 right = _mm256_blendv_ps(_mm256_load_ps(f_.three + i), _mm256_load_ps(f_.four + i), m3);
+    __m256 res = _mm256_blendv_ps(left, right, m1);
+
+    total_lo = _mm256_add_pd(total_lo, _mm256_cvtps_pd(_mm256_castps256_ps128(res)));
+    total_hi = _mm256_add_pd(total_hi, _mm256_cvtps_pd(_mm256_extractf128_ps(res, 1)));
+  }
+
+  __m256d total = _mm256_add_pd(total_lo, total_hi);
+  return horizontal_add(total);
+}
+
+#endif
+
+double rf_sum_soa(const forest2_soa_view &f_, const float *x_)
+{
+  static const simd_isa isa = selected_isa();
+  switch(isa) {
+#if defined(__x86_64__)
+  case simd_isa::avx512:
+    return rf_sum_soa_avx512(f_.a_splitVarID, f_.c_splitVarID, f_.e_splitVarID,
+			     f_.b_splitValue, f_.d_splitValue, f_.f_splitValue,
+			     f_.one, f_.two, f_.three, f_.four, f_.padded_size, x_);
+  default:
+    return rf_sum_soa_avx2(f_, x_);
+#elif defined(__aarch64__)
+  case simd_isa::sve:
+    return rf_sum_soa_sve(f_.a_splitVarID, f_.c_splitVarID, f_.e_splitVarID,
+			  f_.b_splitValue, f_.d_splitValue, f_.f_splitValue,
+			  f_.one, f_.two, f_.three, f_.four, f_.padded_size, x_);
+  default:
+    return rf_sum_soa_neon(f_.a_splitVarID, f_.c_splitVarID, f_.e_splitVarID,
+			   f_.b_splitValue, f_.d_splitValue, f_.f_splitValue,
+			   f_.one, f_.two, f_.three, f_.four, f_.padded_size, x_);
+#endif
+  }
+}
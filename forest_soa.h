@@ -0,0 +1,64 @@
+//
+// structure-of-arrays storage for depth-2 forests
+//
+// tree2 keeps a whole tree together, so tree_eval_simd can only fit two trees in a register and half
+// of the first comparison is redundant.  if we instead keep each field of tree2 in its own array, lane i
+// of every register belongs to tree i and we can do 8 trees at a time:
+//
+// m1 = x[a] <= b
+// m2 = x[c] <= d
+// m3 = x[e] <= f
+// result = m1 ? (m2 ? one : two) : (m3 ? three : four)
+//
+// ie three gathers, three compares and three blends per 8 trees
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "aligned.h"
+#include "forest.h"
+
+// non-owning view of a soa forest, every array holds padded_size entries and is 32-byte aligned
+struct forest2_soa_view {
+  const uint32_t *a_splitVarID, *c_splitVarID, *e_splitVarID;
+  const float *b_splitValue, *d_splitValue, *f_splitValue;
+  const float *one, *two, *three, *four;
+  size_t size;         // number of real trees
+  size_t padded_size;  // size rounded up to a multiple of 8
+};
+
+// soa forest, padded with trees whose leaves are all 0 so the kernel never needs a tail loop
+struct forest2_soa {
+  aligned_vector<uint32_t> a_splitVarID, c_splitVarID, e_splitVarID;
+  aligned_vector<float> b_splitValue, d_splitValue, f_splitValue;
+  aligned_vector<float> one, two, three, four;
+  size_t size = 0;
+
+  forest2_soa() = default;
+  explicit forest2_soa(const forest2 &f_);
+
+  void push_back(const tree2 &t_);
+  forest2_soa_view view() const;
+};
+
+// sum of the tree predictions for sample x_
+double rf_sum_soa(const forest2_soa_view &f_, const float *x_);
+
+#if defined(__x86_64__)
+// the 256-bit version explicitly, whatever the cpu
+double rf_sum_soa_avx2(const forest2_soa_view &f_, const float *x_);
+#endif
+
+// average prediction of the forest for sample x_ (same result as rf_eval on the original forest)
+inline double rf_eval_soa(const forest2_soa_view &f_, const float *x_)
+{
+  return rf_sum_soa(f_, x_) / f_.size;
+}
+
+inline double rf_eval_soa(const forest2_soa &f_, const std::vector<float> &x_)
+{
+  return rf_eval_soa(f_.view(), &x_[0]);
+}
@@ -0,0 +1,45 @@
+//
+// forestc: compiles a forest file into c++ (see codegen.h)
+//
+// usage: forestc model.ssf name [dir]
+//
+// writes dir/name.h and dir/name.cc (dir defaults to the current directory)
+//
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "codegen.h"
+#include "forest_file.h"
+
+int main(int argc, char **argv)
+{
+  if(argc < 3 || argc > 4) {
+    std::cerr << "usage: " << argv[0] << " model.ssf name [dir]" << std::endl;
+    return 2;
+  }
+  const std::string name = argv[2];
+  const std::string dir = argc > 3 ? std::string(argv[3]) + "/" : "";
+
+  try {
+    mapped_forest2_soa f(argv[1]);
+    // generated in memory first, so a bad name or forest doesn't leave half written files behind
+    std::ostringstream h, c;
+    compile_forest2_cpp(f.view(), name, h, c);
+    std::ofstream header(dir + name + ".h"), source(dir + name + ".cc");
+    if(!header || !source) {
+      throw std::runtime_error("can't write " + dir + name + ".h / .cc");
+    }
+    if(!(header << h.str()).flush() || !(source << c.str()).flush()) {
+      throw std::runtime_error("error writing " + dir + name + ".h / .cc");
+    }
+    std::cout << "compiled " << f.view().size << " trees into " << dir + name << ".h / .cc" << std::endl;
+  } catch(const std::exception &e) {
+    std::cerr << argv[0] << ": " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,400 @@
+//
+// cuda offload through the driver api and nvrtc, both loaded at runtime (see gpu.h)
+//
+
+#include "gpu.h"
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel.h"
+
+namespace {
+
+// just enough of cuda.h and nvrtc.h, so the library builds without the toolkit
+typedef int CUresult;
+typedef int CUdevice;
+typedef struct CUctx_st *CUcontext;
+typedef struct CUmod_st *CUmodule;
+typedef struct CUfunc_st *CUfunction;
+typedef struct CUstream_st *CUstream;
+typedef unsigned long long CUdeviceptr;
+typedef int nvrtcResult;
+typedef struct _nvrtcProgram *nvrtcProgram;
+
+const int CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MAJOR = 75;
+const int CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MINOR = 76;
+
+struct cuda_api {
+  CUresult (*cuInit)(unsigned);
+  CUresult (*cuDeviceGetCount)(int *);
+  CUresult (*cuDeviceGet)(CUdevice *, int);
+  CUresult (*cuDeviceGetAttribute)(int *, int, CUdevice);
+  CUresult (*cuDevicePrimaryCtxRetain)(CUcontext *, CUdevice);
+  CUresult (*cuDevicePrimaryCtxRelease)(CUdevice);
+  CUresult (*cuCtxSetCurrent)(CUcontext);
+  CUresult (*cuModuleLoadData)(CUmodule *, const void *);
+  CUresult (*cuModuleUnload)(CUmodule);
+  CUresult (*cuModuleGetFunction)(CUfunction *, CUmodule, const char *);
+  CUresult (*cuMemAlloc)(CUdeviceptr *, size_t);
+  CUresult (*cuMemFree)(CUdeviceptr);
+  CUresult (*cuMemAllocHost)(void **, size_t);
+  CUresult (*cuMemFreeHost)(void *);
+  CUresult (*cuMemcpyHtoD)(CUdeviceptr, const void *, size_t);
+  CUresult (*cuMemcpyDtoH)(void *, CUdeviceptr, size_t);
+  CUresult (*cuLaunchKernel)(CUfunction, unsigned, unsigned, unsigned, unsigned, unsigned, unsigned, unsigned,
+			     CUstream, void **, void **);
+  CUresult (*cuGetErrorString)(CUresult, const char **);
+
+  nvrtcResult (*nvrtcCreateProgram)(nvrtcProgram *, const char *, const char *, int, const char *const *,
+				    const char *const *);
+  nvrtcResult (*nvrtcCompileProgram)(nvrtcProgram, int, const char *const *);
+  nvrtcResult (*nvrtcGetPTXSize)(nvrtcProgram, size_t *);
+  nvrtcResult (*nvrtcGetPTX)(nvrtcProgram, char *);
+  nvrtcResult (*nvrtcGetProgramLogSize)(nvrtcProgram, size_t *);
+  nvrtcResult (*nvrtcGetProgramLog)(nvrtcProgram, char *);
+  nvrtcResult (*nvrtcDestroyProgram)(nvrtcProgram *);
+
+  std::string error;   // empty if everything resolved
+};
+
+// the first of names_ that lib_ has (cuda.h maps most of these to their _v2 versions)
+template<typename F>
+bool resolve(void *lib_, F &fn_, std::initializer_list<const char *> names_)
+{
+  for(const char *n : names_) {
+    if((fn_ = (F)dlsym(lib_, n))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+cuda_api load_cuda()
+{
+  cuda_api api = {};
+  void *cu = dlopen("libcuda.so.1", RTLD_NOW | RTLD_LOCAL);
+  if(!cu) {
+    api.error = std::string("no cuda driver (") + dlerror() + ")";
+    return api;
+  }
+  void *rtc = nullptr;
+  for(const char *n : { "libnvrtc.so", "libnvrtc.so.12", "libnvrtc.so.11.2" }) {
+    if((rtc = dlopen(n, RTLD_NOW | RTLD_LOCAL))) {
+      break;
+    }
+  }
+  if(!rtc) {
+    api.error = "no nvrtc (libnvrtc.so) to compile the kernel with";
+    return api;
+  }
+
+  bool ok = resolve(cu, api.cuInit, { "cuInit" })
+    && resolve(cu, api.cuDeviceGetCount, { "cuDeviceGetCount" })
+    && resolve(cu, api.cuDeviceGet, { "cuDeviceGet" })
+    && resolve(cu, api.cuDeviceGetAttribute, { "cuDeviceGetAttribute" })
+    && resolve(cu, api.cuDevicePrimaryCtxRetain, { "cuDevicePrimaryCtxRetain" })
+    && resolve(cu, api.cuDevicePrimaryCtxRelease, { "cuDevicePrimaryCtxRelease_v2", "cuDevicePrimaryCtxRelease" })
+    && resolve(cu, api.cuCtxSetCurrent, { "cuCtxSetCurrent" })
+    && resolve(cu, api.cuModuleLoadData, { "cuModuleLoadData" })
+    && resolve(cu, api.cuModuleUnload, { "cuModuleUnload" })
+    && resolve(cu, api.cuModuleGetFunction, { "cuModuleGetFunction" })
+    && resolve(cu, api.cuMemAlloc, { "cuMemAlloc_v2" })
+    && resolve(cu, api.cuMemFree, { "cuMemFree_v2" })
+    && resolve(cu, api.cuMemAllocHost, { "cuMemAllocHost_v2" })
+    && resolve(cu, api.cuMemFreeHost, { "cuMemFreeHost" })
+    && resolve(cu, api.cuMemcpyHtoD, { "cuMemcpyHtoD_v2" })
+    && resolve(cu, api.cuMemcpyDtoH, { "cuMemcpyDtoH_v2" })
+    && resolve(cu, api.cuLaunchKernel, { "cuLaunchKernel" })
+    && resolve(cu, api.cuGetErrorString, { "cuGetErrorString" })
+    && resolve(rtc, api.nvrtcCreateProgram, { "nvrtcCreateProgram" })
+    && resolve(rtc, api.nvrtcCompileProgram, { "nvrtcCompileProgram" })
+    && resolve(rtc, api.nvrtcGetPTXSize, { "nvrtcGetPTXSize" })
+    && resolve(rtc, api.nvrtcGetPTX, { "nvrtcGetPTX" })
+    && resolve(rtc, api.nvrtcGetProgramLogSize, { "nvrtcGetProgramLogSize" })
+    && resolve(rtc, api.nvrtcGetProgramLog, { "nvrtcGetProgramLog" })
+    && resolve(rtc, api.nvrtcDestroyProgram, { "nvrtcDestroyProgram" });
+  if(!ok) {
+    api.error = "the cuda driver or nvrtc is missing an entry point (too old?)";
+  } else if(api.cuInit(0) != 0) {
+    api.error = "cuInit failed (no usable device or driver)";
+  }
+  // the libraries stay loaded for the life of the process
+  return api;
+}
+
+const cuda_api &cuda()
+{
+  static const cuda_api api = load_cuda();
+  return api;
+}
+
+void check(CUresult r_, const char *what_)
+{
+  if(r_ != 0) {
+    const char *s = nullptr;
+    cuda().cuGetErrorString(r_, &s);
+    throw std::runtime_error(std::string(what_) + ": " + (s ? s : "cuda error " + std::to_string(r_)));
+  }
+}
+
+// one thread per row, the block's threads share each tile of trees through shared memory
+//
+// ids holds a, c and e (stride apart), vals b, d, f, one, two, three and four, and x is a chunk of rows
+// rows column-major.  a NaN feature fails every <= and goes right, like on the cpu
+const char *KERNEL = R"(
+#define TILE 256
+
+extern "C" __global__ void rf_sum_soa_gpu(const unsigned *ids, const float *vals, unsigned long long trees,
+					  unsigned long long stride, const float *x, unsigned rows, double *out)
+{
+  __shared__ unsigned sid[3][TILE];
+  __shared__ float sval[7][TILE];
+  const unsigned r = blockIdx.x * blockDim.x + threadIdx.x;
+  double total = 0.0;
+
+  for(unsigned long long t0 = 0 ; t0 < trees ; t0 += TILE) {
+    const unsigned n = trees - t0 < TILE ? (unsigned)(trees - t0) : TILE;
+    for(unsigned i = threadIdx.x ; i < n ; i += blockDim.x) {
+      for(int k = 0 ; k < 3 ; ++k) {
+	sid[k][i] = ids[k * stride + t0 + i];
+      }
+      for(int k = 0 ; k < 7 ; ++k) {
+	sval[k][i] = vals[k * stride + t0 + i];
+      }
+    }
+    __syncthreads();
+    if(r < rows) {
+      for(unsigned i = 0 ; i < n ; ++i) {
+	if(x[(size_t)sid[0][i] * rows + r] <= sval[0][i]) {
+	  total += x[(size_t)sid[1][i] * rows + r] <= sval[1][i] ? sval[3][i] : sval[4][i];
+	} else {
+	  total += x[(size_t)sid[2][i] * rows + r] <= sval[2][i] ? sval[5][i] : sval[6][i];
+	}
+      }
+    }
+    __syncthreads();
+  }
+  if(r < rows) {
+    out[r] = total;
+  }
+}
+)";
+
+const unsigned BLOCK = 256;
+
+// the kernel as ptx for device_, trying its own architecture first and nvrtc's default after that
+std::string compile_kernel(CUdevice device_)
+{
+  const cuda_api &api = cuda();
+  int major = 0, minor = 0;
+  api.cuDeviceGetAttribute(&major, CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MAJOR, device_);
+  api.cuDeviceGetAttribute(&minor, CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MINOR, device_);
+  const std::string arch = "--gpu-architecture=compute_" + std::to_string(major * 10 + minor);
+
+  std::string log;
+  for(bool own : { true, false }) {
+    nvrtcProgram prog;
+    if(api.nvrtcCreateProgram(&prog, KERNEL, "rf_sum_soa_gpu.cu", 0, nullptr, nullptr) != 0) {
+      throw std::runtime_error("nvrtc couldn't create the kernel program");
+    }
+    const char *opts[] = { arch.c_str() };
+    nvrtcResult r = api.nvrtcCompileProgram(prog, own ? 1 : 0, opts);
+    std::string ptx;
+    if(r == 0) {
+      size_t n = 0;
+      api.nvrtcGetPTXSize(prog, &n);
+      ptx.resize(n);
+      api.nvrtcGetPTX(prog, &ptx[0]);
+    } else {
+      size_t n = 0;
+      api.nvrtcGetProgramLogSize(prog, &n);
+      log.resize(n);
+      api.nvrtcGetProgramLog(prog, &log[0]);
+    }
+    api.nvrtcDestroyProgram(&prog);
+    if(r == 0) {
+      return ptx;
+    }
+  }
+  throw std::runtime_error("nvrtc couldn't compile the kernel: " + log);
+}
+
+}
+
+// everything that lives on (or is pinned for) the device, freed in reverse
+struct gpu_device {
+  CUdevice device = 0;
+  CUcontext ctx = nullptr;
+  CUmodule module = nullptr;
+  CUfunction kernel = nullptr;
+  CUdeviceptr ids = 0, vals = 0;      // the forest
+  CUdeviceptr x = 0, out = 0;         // one chunk of rows and its sums
+  float *stage[2] = {};               // pinned staging for two chunks
+  size_t capacity = 0;                // floats in x and in each stage
+  size_t rows = 0;                    // doubles in out
+  std::vector<double> sums;
+  std::mutex lock;
+
+  ~gpu_device() {
+    const cuda_api &api = cuda();
+    if(!ctx) {
+      return;
+    }
+    api.cuCtxSetCurrent(ctx);
+    release_chunks();
+    for(CUdeviceptr p : { ids, vals }) {
+      if(p) {
+	api.cuMemFree(p);
+      }
+    }
+    if(module) {
+      api.cuModuleUnload(module);
+    }
+    api.cuDevicePrimaryCtxRelease(device);
+  }
+
+  void release_chunks() {
+    const cuda_api &api = cuda();
+    for(CUdeviceptr p : { x, out }) {
+      if(p) {
+	api.cuMemFree(p);
+      }
+    }
+    for(float *s : stage) {
+      if(s) {
+	api.cuMemFreeHost(s);
+      }
+    }
+    x = out = 0;
+    stage[0] = stage[1] = nullptr;
+    capacity = rows = 0;
+  }
+
+  // room for a chunk of rows_ rows of floats_ floats in all
+  void reserve(size_t floats_, size_t rows_) {
+    const cuda_api &api = cuda();
+    if(floats_ <= capacity && rows_ <= rows) {
+      return;
+    }
+    floats_ = std::max(floats_, capacity);
+    rows_ = std::max(rows_, rows);
+    release_chunks();
+    check(api.cuMemAlloc(&x, floats_ * sizeof(float)), "cuMemAlloc");
+    check(api.cuMemAlloc(&out, rows_ * sizeof(double)), "cuMemAlloc");
+    check(api.cuMemAllocHost((void **)&stage[0], floats_ * sizeof(float)), "cuMemAllocHost");
+    check(api.cuMemAllocHost((void **)&stage[1], floats_ * sizeof(float)), "cuMemAllocHost");
+    capacity = floats_;
+    rows = rows_;
+    sums.resize(rows_);
+  }
+};
+
+gpu_forest2::gpu_forest2(const forest2_soa &f_, size_t min_work_)
+  : f(f_), min(min_work_)
+{
+  const char *env = getenv("SPEEDSTUMPS_GPU");
+  if(env && strcmp(env, "0") == 0) {
+    why = "disabled by SPEEDSTUMPS_GPU=0";
+    return;
+  }
+  const cuda_api &api = cuda();
+  if(!api.error.empty()) {
+    why = api.error;
+    return;
+  }
+  if(f_.size == 0) {
+    why = "empty forest";
+    return;
+  }
+
+  try {
+    int devices = 0;
+    check(api.cuDeviceGetCount(&devices), "cuDeviceGetCount");
+    if(devices == 0) {
+      throw std::runtime_error("no cuda device");
+    }
+    auto d = std::make_unique<gpu_device>();
+    check(api.cuDeviceGet(&d->device, 0), "cuDeviceGet");
+    check(api.cuDevicePrimaryCtxRetain(&d->ctx, d->device), "cuDevicePrimaryCtxRetain");
+    check(api.cuCtxSetCurrent(d->ctx), "cuCtxSetCurrent");
+
+    // compiled once per process, it's always for device 0
+    static const std::string ptx = compile_kernel(d->device);
+    check(api.cuModuleLoadData(&d->module, ptx.c_str()), "cuModuleLoadData");
+    check(api.cuModuleGetFunction(&d->kernel, d->module, "rf_sum_soa_gpu"), "cuModuleGetFunction");
+
+    // a, c, e and b, d, f, one .. four, padded_size apart like on the host
+    const size_t n = f_.one.size();
+    check(api.cuMemAlloc(&d->ids, 3 * n * sizeof(uint32_t)), "cuMemAlloc");
+    check(api.cuMemAlloc(&d->vals, 7 * n * sizeof(float)), "cuMemAlloc");
+    const aligned_vector<uint32_t> *ids[] = { &f_.a_splitVarID, &f_.c_splitVarID, &f_.e_splitVarID };
+    const aligned_vector<float> *vals[] = { &f_.b_splitValue, &f_.d_splitValue, &f_.f_splitValue,
+					    &f_.one, &f_.two, &f_.three, &f_.four };
+    for(size_t k = 0 ; k < 3 ; ++k) {
+      check(api.cuMemcpyHtoD(d->ids + k * n * sizeof(uint32_t), ids[k]->data(), n * sizeof(uint32_t)), "cuMemcpyHtoD");
+    }
+    for(size_t k = 0 ; k < 7 ; ++k) {
+      check(api.cuMemcpyHtoD(d->vals + k * n * sizeof(float), vals[k]->data(), n * sizeof(float)), "cuMemcpyHtoD");
+    }
+    dev = std::move(d);
+  } catch(const std::runtime_error &e) {
+    why = e.what();
+  }
+}
+
+gpu_forest2::~gpu_forest2() = default;
+
+void rf_eval_gpu_batch(const gpu_forest2 &f_, const float *x_, size_t rows_, size_t num_preds_, double *out,
+		       worker_pool &pool_)
+{
+  gpu_device *d = f_.dev.get();
+  if(!d || (double)rows_ * f_.f.size < f_.min) {
+    rf_eval_parallel_batch(f_.f, x_, rows_, num_preds_, out, pool_);
+    return;
+  }
+
+  const cuda_api &api = cuda();
+  std::lock_guard<std::mutex> l(d->lock);
+  check(api.cuCtxSetCurrent(d->ctx), "cuCtxSetCurrent");
+  const size_t chunk = std::min(rows_, GPU_CHUNK);
+  const size_t chunks = (rows_ + chunk - 1) / chunk;
+  d->reserve(chunk * num_preds_, chunk);
+
+  // rows [c_ * chunk, + n) into stage c_ & 1, column-major
+  auto stage = [&](size_t c_) {
+    const size_t first = c_ * chunk, n = std::min(chunk, rows_ - first);
+    float *s = d->stage[c_ & 1];
+    for(size_t r = 0 ; r < n ; ++r) {
+      const float *row = x_ + (first + r) * num_preds_;
+      for(size_t j = 0 ; j < num_preds_ ; ++j) {
+	s[j * n + r] = row[j];
+      }
+    }
+  };
+
+  stage(0);
+  unsigned long long trees = f_.f.size, stride = f_.f.one.size();
+  for(size_t c = 0 ; c < chunks ; ++c) {
+    const size_t first = c * chunk;
+    unsigned n = std::min(chunk, rows_ - first);
+    check(api.cuMemcpyHtoD(d->x, d->stage[c & 1], n * num_preds_ * sizeof(float)), "cuMemcpyHtoD");
+    void *args[] = { &d->ids, &d->vals, &trees, &stride, &d->x, &n, &d->out };
+    check(api.cuLaunchKernel(d->kernel, (n + BLOCK - 1) / BLOCK, 1, 1, BLOCK, 1, 1, 0, nullptr, args, nullptr),
+	  "cuLaunchKernel");
+    // the launch is asynchronous, so the next chunk is transposed while this one is scored
+    if(c + 1 < chunks) {
+      stage(c + 1);
+    }
+    check(api.cuMemcpyDtoH(&d->sums[0], d->out, n * sizeof(double)), "cuMemcpyDtoH");
+    for(size_t r = 0 ; r < n ; ++r) {
+      out[first + r] = d->sums[r] / f_.f.size;
+    }
+  }
+}
@@ -0,0 +1,67 @@
+//
+// gpu offload for very large batches of rows against a depth-2 forest
+//
+// a gpu_forest2 uploads the soa arrays once.  rf_eval_gpu_batch then works like rf_eval_parallel_batch,
+// but sends the rows to the device in chunks of GPU_CHUNK: each chunk is transposed to column-major on the
+// host (while the previous chunk is being scored), copied over, and scored with one thread per row.  the
+// threads of a block walk the trees together through shared memory, so every tree is read once per block
+// and, with the rows column-major, the features of consecutive rows are consecutive in memory
+//
+// there's no build time dependency: the backend is cuda, and everything it needs (libcuda.so.1 for the
+// device, libnvrtc to compile the kernel for it) is loaded with dlopen the first time a gpu_forest2 is
+// built.  without them, without a device, or with SPEEDSTUMPS_GPU=0 the forest stays on the host and the
+// batches go to rf_eval_parallel_batch, as do batches too small to pay for the transfers
+//
+// the device sums each row in double in tree order, so results agree with the cpu kernels to about one
+// float rounding of the leaves (as check.h holds them), not bit for bit
+//
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "forest_soa.h"
+#include "pool.h"
+
+// rows per transfer, 64k rows of 256 predictors is 64MB
+const size_t GPU_CHUNK = 1 << 16;
+
+// batches with fewer trees x rows than this are scored on the cpu: a launch and two copies cost tens of
+// microseconds, about what the cpu needs for this much work
+const size_t GPU_MIN_WORK = size_t(1) << 24;
+
+struct gpu_device;
+
+class gpu_forest2 {
+public:
+  // f_ must outlive this, it's what the cpu fallback (and rf_eval_gpu_batch's small batches) score
+  explicit gpu_forest2(const forest2_soa &f_, size_t min_work_ = GPU_MIN_WORK);
+  ~gpu_forest2();
+
+  gpu_forest2(const gpu_forest2 &) = delete;
+  gpu_forest2 &operator=(const gpu_forest2 &) = delete;
+
+  // whether the forest made it onto a device, and if not why not
+  bool on_device() const { return dev != nullptr; }
+  const std::string &error() const { return why; }
+
+  const forest2_soa &host() const { return f; }
+  size_t min_work() const { return min; }
+
+private:
+  const forest2_soa &f;
+  size_t min;
+  std::unique_ptr<gpu_device> dev;
+  std::string why;
+
+  friend void rf_eval_gpu_batch(const gpu_forest2 &f_, const float *x_, size_t rows_, size_t num_preds_, double *out,
+				worker_pool &pool_);
+};
+
+// score rows_ row-major samples (num_preds_ predictors each) against f_, out receives rf_eval_soa's result
+// for each row.  batches are serialized on the device, calls from several threads just take turns.  throws
+// std::runtime_error if the device fails part way through a batch
+void rf_eval_gpu_batch(const gpu_forest2 &f_, const float *x_, size_t rows_, size_t num_preds_, double *out,
+		       worker_pool &pool_ = default_pool());
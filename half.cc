@@ -0,0 +1,215 @@
+//
+// 16-bit forest storage (see half.h)
+//
+
+#include "half.h"
+
+#include <bit>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "simd.h"
+
+uint16_t to_half(float v_, half_format format_)
+{
+  uint32_t f = std::bit_cast<uint32_t>(v_);
+
+  if(format_ == half_format::bf16) {
+    if((f & 0x7fffffff) > 0x7f800000) {
+      return (f >> 16) | 0x40; // keep NaNs quiet rather than rounding them to inf
+    }
+    f += 0x7fff + ((f >> 16) & 1);
+    return f >> 16;
+  }
+
+  uint16_t sign = (f >> 16) & 0x8000;
+  int32_t exp = (int32_t)((f >> 23) & 0xff) - 127 + 15;
+  uint32_t mant = f & 0x7fffff;
+
+  if(((f >> 23) & 0xff) == 0xff) {
+    return sign | 0x7c00 | (mant ? 0x200 : 0);
+  }
+  if(exp >= 31) {
+    return sign | 0x7c00;
+  }
+
+  uint32_t shift = 13, h;
+  if(exp <= 0) {
+    // subnormal half, the implicit bit becomes explicit
+    if(exp < -10) {
+      return sign;
+    }
+    mant |= 0x800000;
+    shift = 14 - exp;
+    h = mant >> shift;
+  } else {
+    h = ((uint32_t)exp << 10) | (mant >> shift);
+  }
+
+  // a carry out of the mantissa correctly bumps the exponent (up to inf)
+  uint32_t rem = mant & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+  if(rem > halfway || (rem == halfway && (h & 1))) {
+    ++h;
+  }
+  return sign | h;
+}
+
+float from_half(uint16_t h_, half_format format_)
+{
+  if(format_ == half_format::bf16) {
+    return std::bit_cast<float>((uint32_t)h_ << 16);
+  }
+
+  uint32_t sign = (uint32_t)(h_ & 0x8000) << 16;
+  uint32_t exp = (h_ >> 10) & 0x1f;
+  uint32_t mant = h_ & 0x3ff;
+
+  if(exp == 0x1f) {
+    return std::bit_cast<float>(sign | 0x7f800000 | (mant << 13));
+  }
+  if(exp == 0) {
+    if(mant == 0) {
+      return std::bit_cast<float>(sign);
+    }
+    // subnormal, renormalize for the float exponent
+    exp = 127 - 15 + 1;
+    while(!(mant & 0x400)) {
+      mant <<= 1;
+      --exp;
+    }
+    return std::bit_cast<float>(sign | (exp << 23) | ((mant & 0x3ff) << 13));
+  }
+  return std::bit_cast<float>(sign | ((exp + 127 - 15) << 23) | (mant << 13));
+}
+
+const char *half_format_name(half_format format_)
+{
+  return format_ == half_format::fp16 ? "fp16" : "bf16";
+}
+
+// v_ rounded into a padded 16-bit array
+static aligned_vector<uint16_t> narrow(const aligned_vector<float> &v_, half_format format_)
+{
+  aligned_vector<uint16_t> out(v_.size());
+  for(size_t i = 0 ; i < v_.size() ; ++i) {
+    out[i] = to_half(v_[i], format_);
+  }
+  return out;
+}
+
+stump_forest_half::stump_forest_half(const stump_forest &f_, half_format format_)
+  : splitVarID(f_.splitVarID), splitValue(narrow(f_.splitValue, format_)),
+    left(narrow(f_.left, format_)), right(narrow(f_.right, format_)), size(f_.size), format(format_)
+{
+}
+
+forest2_soa_half::forest2_soa_half(const forest2_soa &f_, half_format format_)
+  : a_splitVarID(f_.a_splitVarID), c_splitVarID(f_.c_splitVarID), e_splitVarID(f_.e_splitVarID),
+    b_splitValue(narrow(f_.b_splitValue, format_)), d_splitValue(narrow(f_.d_splitValue, format_)),
+    f_splitValue(narrow(f_.f_splitValue, format_)),
+    one(narrow(f_.one, format_)), two(narrow(f_.two, format_)),
+    three(narrow(f_.three, format_)), four(narrow(f_.four, format_)),
+    size(f_.size), format(format_)
+{
+}
+
+#if defined(__x86_64__)
+
+// 8 16-bit values (16-byte aligned) widened to floats
+template<half_format F>
+static inline __m256 widen8(const uint16_t *p_)
+{
+  __m128i h = _mm_load_si128((const __m128i *)p_);
+  if constexpr (F == half_format::fp16) {
+    return _mm256_cvtph_ps(h);
+  } else {
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+  }
+}
+
+// rf_sum_stumps_avx2 with widening loads
+template<half_format F>
+static double rf_sum_stumps_half_avx2(const stump_forest_half &f_, const float *x_)
+{
+  __m256d tot = _mm256_setzero_pd();
+  for(size_t i = 0 ; i < f_.left.size() ; i += 8) {
+    __m256 a = _mm256_i32gather_ps(x_, _mm256_load_si256((const __m256i *)&f_.splitVarID[i]), 4);
+    __m256 mask = _mm256_cmp_ps(a, widen8<F>(&f_.splitValue[i]), _CMP_NLE_UQ); // !(<=), so NaNs go right
+    __m256 res = _mm256_blendv_ps(widen8<F>(&f_.left[i]), widen8<F>(&f_.right[i]), mask);
+    tot = _mm256_add_pd(tot, _mm256_cvtps_pd(_mm256_castps256_ps128(res)));
+    tot = _mm256_add_pd(tot, _mm256_cvtps_pd(_mm256_extractf128_ps(res, 1)));
+  }
+  return horizontal_add(tot);
+}
+
+// rf_sum_soa_avx2 with widening loads
+template<half_format F>
+static double rf_sum_soa_half_avx2(const forest2_soa_half &f_, const float *x_)
+{
+  __m256d total_lo = _mm256_setzero_pd();
+  __m256d total_hi = _mm256_setzero_pd();
+
+  for(size_t i = 0 ; i < f_.one.size() ; i += 8) {
+    __m256 xa = _mm256_i32gather_ps(x_, _mm256_load_si256((const __m256i *)&f_.a_splitVarID[i]), 4);
+    __m256 xc = _mm256_i32gather_ps(x_, _mm256_load_si256((const __m256i *)&f_.c_splitVarID[i]), 4);
+    __m256 xe = _mm256_i32gather_ps(x_, _mm256_load_si256((const __m256i *)&f_.e_splitVarID[i]), 4);
+
+    __m256 m1 = _mm256_cmp_ps(xa, widen8<F>(&f_.b_splitValue[i]), _CMP_NLE_UQ);
+    __m256 m2 = _mm256_cmp_ps(xc, widen8<F>(&f_.d_splitValue[i]), _CMP_NLE_UQ);
+    __m256 m3 = _mm256_cmp_ps(xe, widen8<F>(&f_.f_splitValue[i]), _CMP_NLE_UQ);
+
+    __m256 left = _mm256_blendv_ps(widen8<F>(&f_.one[i]), widen8<F>(&f_.two[i]), m2);
+    __m256 right = _mm256_blendv_ps(widen8<F>(&f_.three[i]), widen8<F>(&f_.four[i]), m3);
+    __m256 res = _mm256_blendv_ps(left, right, m1);
+
+    total_lo = _mm256_add_pd(total_lo, _mm256_cvtps_pd(_mm256_castps256_ps128(res)));
+    total_hi = _mm256_add_pd(total_hi, _mm256_cvtps_pd(_mm256_extractf128_ps(res, 1)));
+  }
+
+  __m256d total = _mm256_add_pd(total_lo, total_hi);
+  return horizontal_add(total);
+}
+
+double rf_sum_stumps_half(const stump_forest_half &f_, const float *x_)
+{
+  return f_.format == half_format::fp16 ? rf_sum_stumps_half_avx2<half_format::fp16>(f_, x_)
+    : rf_sum_stumps_half_avx2<half_format::bf16>(f_, x_);
+}
+
+double rf_sum_soa_half(const forest2_soa_half &f_, const float *x_)
+{
+  return f_.format == half_format::fp16 ? rf_sum_soa_half_avx2<half_format::fp16>(f_, x_)
+    : rf_sum_soa_half_avx2<half_format::bf16>(f_, x_);
+}
+
+#else
+
+// no vector version elsewhere yet, the same walk one stump/tree at a time
+
+double rf_sum_stumps_half(const stump_forest_half &f_, const float *x_)
+{
+  double tot = 0.0;
+  for(size_t i = 0 ; i < f_.size ; ++i) {
+    tot += x_[f_.splitVarID[i]] <= from_half(f_.splitValue[i], f_.format) ?
+      from_half(f_.left[i], f_.format) : from_half(f_.right[i], f_.format);
+  }
+  return tot;
+}
+
+double rf_sum_soa_half(const forest2_soa_half &f_, const float *x_)
+{
+  auto h = [&](uint16_t v_) { return from_half(v_, f_.format); };
+  double tot = 0.0;
+  for(size_t i = 0 ; i < f_.size ; ++i) {
+    if(x_[f_.a_splitVarID[i]] <= h(f_.b_splitValue[i])) {
+      tot += x_[f_.c_splitVarID[i]] <= h(f_.d_splitValue[i]) ? h(f_.one[i]) : h(f_.two[i]);
+    } else {
+      tot += x_[f_.e_splitVarID[i]] <= h(f_.f_splitValue[i]) ? h(f_.three[i]) : h(f_.four[i]);
+    }
+  }
+  return tot;
+}
+
+#endif
@@ -0,0 +1,67 @@
+//
+// reduced precision (16-bit) storage for stump and depth-2 forests
+//
+// evaluation is bound by how fast we can stream the model in, and thresholds and leaves are most of it:
+// a stump is a 4 byte feature id plus three floats, a soa depth-2 tree three ids plus seven floats.  keeping
+// the floats as 16 bits cuts that to 10 and 26 bytes, and the kernels widen them back in-register:
+//
+// fp16 : ieee half, 11 bits of precision but only +-65504 of range (_mm256_cvtph_ps, f16c)
+// bf16 : the top half of a float, 8 bits of precision with the full float range (a 16 bit shift)
+//
+// features stay 32-bit and are compared against the widened threshold, so the results differ from the
+// fp32 forest only where a feature falls between a threshold and its rounded value, plus the leaf rounding.
+// vectest and vectest2 report the error against rf_eval
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "aligned.h"
+#include "forest_soa.h"
+#include "stumps.h"
+
+enum class half_format { fp16, bf16 };
+
+// round to nearest even (overflow goes to inf for fp16, NaNs stay NaNs)
+uint16_t to_half(float v_, half_format format_);
+float from_half(uint16_t h_, half_format format_);
+
+const char *half_format_name(half_format format_);
+
+// stump_forest with 16-bit thresholds and leaves, padded to a multiple of 8 the same way
+struct stump_forest_half {
+  aligned_vector<uint32_t> splitVarID;
+  aligned_vector<uint16_t> splitValue;
+  aligned_vector<uint16_t> left, right;
+  size_t size = 0;
+  half_format format;
+
+  stump_forest_half(const stump_forest &f_, half_format format_);
+};
+
+// forest2_soa with 16-bit thresholds and leaves
+struct forest2_soa_half {
+  aligned_vector<uint32_t> a_splitVarID, c_splitVarID, e_splitVarID;
+  aligned_vector<uint16_t> b_splitValue, d_splitValue, f_splitValue;
+  aligned_vector<uint16_t> one, two, three, four;
+  size_t size = 0;
+  half_format format;
+
+  forest2_soa_half(const forest2_soa &f_, half_format format_);
+};
+
+// sums of the predictions for sample x_, like rf_sum_stumps and rf_sum_soa
+double rf_sum_stumps_half(const stump_forest_half &f_, const float *x_);
+double rf_sum_soa_half(const forest2_soa_half &f_, const float *x_);
+
+inline double rf_eval_stumps_half(const stump_forest_half &f_, const float *x_)
+{
+  return rf_sum_stumps_half(f_, x_) / f_.size;
+}
+
+inline double rf_eval_soa_half(const forest2_soa_half &f_, const float *x_)
+{
+  return rf_sum_soa_half(f_, x_) / f_.size;
+}
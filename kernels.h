@@ -0,0 +1,65 @@
+//
+// per-isa versions of the stump and depth-2 kernels, behind the dispatching entry points
+//
+// selectf, selectf2, rf_sum_stumps and rf_sum_soa pick one of these the first time they're called, based
+// on selected_isa() (see cpu.h), so the rest of the library never deals with the isa:
+//
+// x86     : avx2 (stumps.cc / forest_soa.cc) or avx-512 (kernels_avx512.cc)
+// aarch64 : neon (kernels_neon.cc) or sve (kernels_sve.cc)
+//
+// the avx-512 and sve files are built with extra -m flags and must only be called when the cpu supports
+// them.  that's also why the interface here is raw pointers only: those files must not include any header
+// with inline functions or templates, since their copies of those could be picked by the linker for the
+// rest of the library
+//
+// for the stump and soa kernels n_ is the padded number of stumps/trees (a multiple of 8)
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__)
+
+// selectf covering 16 stumps per instruction (any count and alignment, like selectf)
+float selectf_avx512(const float *a, const float *b, const float *x, const float *y, size_t count);
+
+double rf_sum_stumps_avx512(const uint32_t *splitVarID_, const float *splitValue_, const float *left_, const float *right_,
+			    size_t n_, const float *x_);
+
+// rf_sum_stumps_avx512 for rows_ samples, row r at x_ + r * stride_, into out[r]
+void rf_sum_stumps_batch_avx512(const uint32_t *splitVarID_, const float *splitValue_, const float *left_,
+				const float *right_, size_t n_, const float *x_, size_t rows_, size_t stride_, double *out);
+
+double rf_sum_soa_avx512(const uint32_t *a_, const uint32_t *c_, const uint32_t *e_,
+			 const float *b_, const float *d_, const float *f_,
+			 const float *one_, const float *two_, const float *three_, const float *four_,
+			 size_t n_, const float *x_);
+
+#elif defined(__aarch64__)
+
+// selectf/selectf2 with 128-bit neon registers, any count and alignment
+float selectf_neon(const float *a, const float *b, const float *x, const float *y, size_t count);
+float selectf2_neon(const float *a, const float *b, const float *x, const float *y, size_t count);
+
+double rf_sum_stumps_neon(const uint32_t *splitVarID_, const float *splitValue_, const float *left_, const float *right_,
+			  size_t n_, const float *x_);
+
+double rf_sum_soa_neon(const uint32_t *a_, const uint32_t *c_, const uint32_t *e_,
+		       const float *b_, const float *d_, const float *f_,
+		       const float *one_, const float *two_, const float *three_, const float *four_,
+		       size_t n_, const float *x_);
+
+// the same with scalable vectors, whatever the sve vector length
+float selectf_sve(const float *a, const float *b, const float *x, const float *y, size_t count);
+
+double rf_sum_stumps_sve(const uint32_t *splitVarID_, const float *splitValue_, const float *left_, const float *right_,
+			 size_t n_, const float *x_);
+
+double rf_sum_soa_sve(const uint32_t *a_, const uint32_t *c_, const uint32_t *e_,
+		      const float *b_, const float *d_, const float *f_,
+		      const float *one_, const float *two_, const float *three_, const float *four_,
+		      size_t n_, const float *x_);
+
+#endif
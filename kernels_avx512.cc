@@ -0,0 +1,123 @@
+//
+// avx-512 stump and depth-2 kernels (see kernels.h, and stumps.cc/forest_soa.cc for the avx2 versions)
+//
+// same ideas as the avx2 kernels with 16 lanes, except that compares produce a __mmask16 instead of a
+// vector mask and the selection is a masked blend.  the final partial group is done with masked loads
+//
+
+#include "kernels.h"
+
+#include <immintrin.h>
+
+// gcc 12's avx512fintrin.h builds the 512 -> 256 casts and reductions on top of _mm256_undefined_*,
+// which -Wuninitialized then flags at every use
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+namespace {
+
+// local helpers rather than simd.h, see kernels.h
+
+// accumulate 16 floats into 8 double lanes
+inline __m512d widen_add(__m512d tot_, __m512 v_)
+{
+  tot_ = _mm512_add_pd(tot_, _mm512_cvtps_pd(_mm512_castps512_ps256(v_)));
+  return _mm512_add_pd(tot_, _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v_), 1))));
+}
+
+}
+
+float selectf_avx512(const float *a, const float *b, const float *x, const float *y, size_t count)
+{
+  __m512 tot = _mm512_setzero_ps();
+  for(size_t i = 0 ; i < count ; i += 16) {
+    __mmask16 k = count - i >= 16 ? 0xffff : (__mmask16)((1u << (count - i)) - 1);
+    __m512 av = _mm512_maskz_loadu_ps(k, a + i);
+    __m512 bv = _mm512_maskz_loadu_ps(k, b + i);
+    __mmask16 gt = _mm512_mask_cmp_ps_mask(k, av, bv, _CMP_NLE_UQ); // !(<=), like selectf
+    __m512 res = _mm512_mask_blend_ps(gt, _mm512_maskz_loadu_ps(k, x + i), _mm512_maskz_loadu_ps(k, y + i));
+    tot = _mm512_mask_add_ps(tot, k, tot, res);
+  }
+  return _mm512_reduce_add_ps(tot) / count;
+}
+
+double rf_sum_stumps_avx512(const uint32_t *splitVarID_, const float *splitValue_, const float *left_, const float *right_,
+			    size_t n_, const float *x_)
+{
+  __m512d tot = _mm512_setzero_pd();
+  for(size_t i = 0 ; i < n_ ; i += 16) {
+    __mmask16 k = n_ - i >= 16 ? 0xffff : 0x00ff;
+    __m512i id = _mm512_maskz_loadu_epi32(k, splitVarID_ + i);
+    __m512 a = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), k, id, x_, 4);
+    __mmask16 right = _mm512_mask_cmp_ps_mask(k, a, _mm512_maskz_loadu_ps(k, splitValue_ + i), _CMP_NLE_UQ);
+    __m512 res = _mm512_mask_blend_ps(right, _mm512_maskz_loadu_ps(k, left_ + i), _mm512_maskz_loadu_ps(k, right_ + i));
+    tot = widen_add(tot, res);
+  }
+  return _mm512_reduce_add_pd(tot);
+}
+
+namespace {
+
+// ROWS samples at once, each block of stumps loaded once for all of them.  a row's sum is added up exactly
+// as rf_sum_stumps_avx512 adds it
+template<size_t ROWS>
+inline void stumps_tile(const uint32_t *splitVarID_, const float *splitValue_, const float *left_, const float *right_,
+			size_t n_, const float *x_, size_t stride_, double *out)
+{
+  __m512d tot[ROWS];
+  for(size_t r = 0 ; r < ROWS ; ++r) {
+    tot[r] = _mm512_setzero_pd();
+  }
+  for(size_t i = 0 ; i < n_ ; i += 16) {
+    __mmask16 k = n_ - i >= 16 ? 0xffff : 0x00ff;
+    __m512i id = _mm512_maskz_loadu_epi32(k, splitVarID_ + i);
+    __m512 b = _mm512_maskz_loadu_ps(k, splitValue_ + i);
+    __m512 left = _mm512_maskz_loadu_ps(k, left_ + i);
+    __m512 right = _mm512_maskz_loadu_ps(k, right_ + i);
+    for(size_t r = 0 ; r < ROWS ; ++r) {
+      __m512 a = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), k, id, x_ + r * stride_, 4);
+      tot[r] = widen_add(tot[r], _mm512_mask_blend_ps(_mm512_mask_cmp_ps_mask(k, a, b, _CMP_NLE_UQ), left, right));
+    }
+  }
+  for(size_t r = 0 ; r < ROWS ; ++r) {
+    out[r] = _mm512_reduce_add_pd(tot[r]);
+  }
+}
+
+}
+
+void rf_sum_stumps_batch_avx512(const uint32_t *splitVarID_, const float *splitValue_, const float *left_,
+				const float *right_, size_t n_, const float *x_, size_t rows_, size_t stride_, double *out)
+{
+  size_t r = 0;
+  for( ; r + 8 <= rows_ ; r += 8) {
+    stumps_tile<8>(splitVarID_, splitValue_, left_, right_, n_, x_ + r * stride_, stride_, out + r);
+  }
+  for( ; r < rows_ ; ++r) {
+    stumps_tile<1>(splitVarID_, splitValue_, left_, right_, n_, x_ + r * stride_, stride_, out + r);
+  }
+}
+
+double rf_sum_soa_avx512(const uint32_t *a_, const uint32_t *c_, const uint32_t *e_,
+			 const float *b_, const float *d_, const float *f_,
+			 const float *one_, const float *two_, const float *three_, const float *four_,
+			 size_t n_, const float *x_)
+{
+  __m512d tot = _mm512_setzero_pd();
+  const __m512 zero = _mm512_setzero_ps();
+  for(size_t i = 0 ; i < n_ ; i += 16) {
+    __mmask16 k = n_ - i >= 16 ? 0xffff : 0x00ff;
+    __m512 xa = _mm512_mask_i32gather_ps(zero, k, _mm512_maskz_loadu_epi32(k, a_ + i), x_, 4);
+    __m512 xc = _mm512_mask_i32gather_ps(zero, k, _mm512_maskz_loadu_epi32(k, c_ + i), x_, 4);
+    __m512 xe = _mm512_mask_i32gather_ps(zero, k, _mm512_maskz_loadu_epi32(k, e_ + i), x_, 4);
+
+    __mmask16 m1 = _mm512_mask_cmp_ps_mask(k, xa, _mm512_maskz_loadu_ps(k, b_ + i), _CMP_NLE_UQ);
+    __mmask16 m2 = _mm512_mask_cmp_ps_mask(k, xc, _mm512_maskz_loadu_ps(k, d_ + i), _CMP_NLE_UQ);
+    __mmask16 m3 = _mm512_mask_cmp_ps_mask(k, xe, _mm512_maskz_loadu_ps(k, f_ + i), _CMP_NLE_UQ);
+
+    __m512 left = _mm512_mask_blend_ps(m2, _mm512_maskz_loadu_ps(k, one_ + i), _mm512_maskz_loadu_ps(k, two_ + i));
+    __m512 right = _mm512_mask_blend_ps(m3, _mm512_maskz_loadu_ps(k, three_ + i), _mm512_maskz_loadu_ps(k, four_ + i));
+    tot = widen_add(tot, _mm512_mask_blend_ps(m1, left, right));
+  }
+  return _mm512_reduce_add_pd(tot);
+}
@@ -0,0 +1,107 @@
+//
+// neon stump and depth-2 kernels (see kernels.h, and stumps.cc/forest_soa.cc for the avx2 versions)
+//
+// the same compare / select / accumulate pipeline in 128-bit registers:
+//
+// _mm256_cmp_ps    -> vcgtq_f32 / vcleq_f32
+// _mm256_blendv_ps -> vbslq_f32 (note the mask comes first and selects the first value)
+// _mm256_add_ps    -> vaddq_f32
+//
+// neon has no masked loads, so the last partial register of selectf/selectf2 is done in scalar code, and no
+// gather, so the stump and soa kernels load the features with scalar loads into a register
+//
+
+#include "kernels.h"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+namespace {
+
+// x_[id_[0..3]]
+inline float32x4_t load_features(const float *x_, const uint32_t *id_)
+{
+  float32x4_t v = vdupq_n_f32(x_[id_[0]]);
+  v = vsetq_lane_f32(x_[id_[1]], v, 1);
+  v = vsetq_lane_f32(x_[id_[2]], v, 2);
+  return vsetq_lane_f32(x_[id_[3]], v, 3);
+}
+
+// !(a <= b), ie true for a NaN feature so it goes right like in tree_eval
+inline uint32x4_t cmp_nle(float32x4_t a_, float32x4_t b_)
+{
+  return vmvnq_u32(vcleq_f32(a_, b_));
+}
+
+// accumulate 4 floats into 2 double lanes
+inline float64x2_t widen_add(float64x2_t tot_, float32x4_t v_)
+{
+  tot_ = vaddq_f64(tot_, vcvt_f64_f32(vget_low_f32(v_)));
+  return vaddq_f64(tot_, vcvt_high_f64_f32(v_));
+}
+
+}
+
+float selectf_neon(const float *a, const float *b, const float *x, const float *y, size_t count)
+{
+  float32x4_t tot1 = vdupq_n_f32(0.0f), tot2 = vdupq_n_f32(0.0f);
+  size_t n = (count >> 3) << 3;
+  for(size_t i = 0 ; i < n ; i += 8) {
+    uint32x4_t mask1 = cmp_nle(vld1q_f32(a + i), vld1q_f32(b + i)); // !(<=), like selectf
+    uint32x4_t mask2 = cmp_nle(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    tot1 = vaddq_f32(tot1, vbslq_f32(mask1, vld1q_f32(y + i), vld1q_f32(x + i)));
+    tot2 = vaddq_f32(tot2, vbslq_f32(mask2, vld1q_f32(y + i + 4), vld1q_f32(x + i + 4)));
+  }
+  float tail = 0.0f;
+  for(size_t i = n ; i < count ; ++i) {
+    tail += a[i] <= b[i] ? x[i] : y[i];
+  }
+  return (vaddvq_f32(vaddq_f32(tot1, tot2)) + tail) / count;
+}
+
+float selectf2_neon(const float *a, const float *b, const float *x, const float *y, size_t count)
+{
+  float32x4_t tot = vdupq_n_f32(0.0f);
+  size_t n = (count >> 2) << 2;
+  for(size_t i = 0 ; i < n ; i += 4) {
+    uint32x4_t mask = cmp_nle(vld1q_f32(a + i), vld1q_f32(b + i));
+    tot = vaddq_f32(tot, vbslq_f32(mask, vld1q_f32(y + i), vld1q_f32(x + i)));
+  }
+  float tail = 0.0f;
+  for(size_t i = n ; i < count ; ++i) {
+    tail += a[i] <= b[i] ? x[i] : y[i];
+  }
+  return (vaddvq_f32(tot) + tail) / count;
+}
+
+double rf_sum_stumps_neon(const uint32_t *splitVarID_, const float *splitValue_, const float *left_, const float *right_,
+			  size_t n_, const float *x_)
+{
+  float64x2_t tot = vdupq_n_f64(0.0);
+  for(size_t i = 0 ; i < n_ ; i += 4) {
+    uint32x4_t right = cmp_nle(load_features(x_, splitVarID_ + i), vld1q_f32(splitValue_ + i));
+    tot = widen_add(tot, vbslq_f32(right, vld1q_f32(right_ + i), vld1q_f32(left_ + i)));
+  }
+  return vaddvq_f64(tot);
+}
+
+double rf_sum_soa_neon(const uint32_t *a_, const uint32_t *c_, const uint32_t *e_,
+		       const float *b_, const float *d_, const float *f_,
+		       const float *one_, const float *two_, const float *three_, const float *four_,
+		       size_t n_, const float *x_)
+{
+  float64x2_t tot = vdupq_n_f64(0.0);
+  for(size_t i = 0 ; i < n_ ; i += 4) {
+    uint32x4_t m1 = cmp_nle(load_features(x_, a_ + i), vld1q_f32(b_ + i));
+    uint32x4_t m2 = cmp_nle(load_features(x_, c_ + i), vld1q_f32(d_ + i));
+    uint32x4_t m3 = cmp_nle(load_features(x_, e_ + i), vld1q_f32(f_ + i));
+
+    float32x4_t left = vbslq_f32(m2, vld1q_f32(two_ + i), vld1q_f32(one_ + i));
+    float32x4_t right = vbslq_f32(m3, vld1q_f32(four_ + i), vld1q_f32(three_ + i));
+    tot = widen_add(tot, vbslq_f32(m1, right, left));
+  }
+  return vaddvq_f64(tot);
+}
+
+#endif
@@ -0,0 +1,81 @@
+//
+// sve stump and depth-2 kernels (see kernels.h, and stumps.cc/forest_soa.cc for the avx2 versions)
+//
+// vector length agnostic versions of the neon kernels: predicated loads cover the last partial vector,
+// compares produce a predicate (like the avx-512 mask registers), svsel does the select, and sve has
+// real gathers (svld1_gather_u32index_f32) for the features
+//
+// the float results are widened to double by converting the even and (shifted down) odd lanes separately
+//
+
+#include "kernels.h"
+
+#if defined(__aarch64__)
+
+#include <arm_sve.h>
+
+namespace {
+
+// accumulate the active lanes of v_ into double lanes
+inline svfloat64_t widen_add(svfloat64_t tot_, svbool_t pg_, svfloat32_t v_)
+{
+  const svbool_t all = svptrue_b64();
+  v_ = svsel_f32(pg_, v_, svdup_n_f32(0.0f));
+  svfloat32_t odd = svreinterpret_f32_u64(svlsr_n_u64_x(all, svreinterpret_u64_f32(v_), 32));
+  tot_ = svadd_f64_x(all, tot_, svcvt_f64_f32_x(all, v_));
+  return svadd_f64_x(all, tot_, svcvt_f64_f32_x(all, odd));
+}
+
+// !(a <= b), ie true for a NaN feature so it goes right like in tree_eval
+inline svbool_t cmp_nle(svbool_t pg_, svfloat32_t a_, svfloat32_t b_)
+{
+  return svnot_b_z(pg_, svcmple_f32(pg_, a_, b_));
+}
+
+}
+
+float selectf_sve(const float *a, const float *b, const float *x, const float *y, size_t count)
+{
+  svfloat32_t tot = svdup_n_f32(0.0f);
+  for(uint64_t i = 0 ; i < count ; i += svcntw()) {
+    svbool_t pg = svwhilelt_b32_u64(i, count);
+    svbool_t gt = cmp_nle(pg, svld1_f32(pg, a + i), svld1_f32(pg, b + i)); // !(<=), like selectf
+    svfloat32_t res = svsel_f32(gt, svld1_f32(pg, y + i), svld1_f32(pg, x + i));
+    tot = svadd_f32_m(pg, tot, res);
+  }
+  return svaddv_f32(svptrue_b32(), tot) / count;
+}
+
+double rf_sum_stumps_sve(const uint32_t *splitVarID_, const float *splitValue_, const float *left_, const float *right_,
+			 size_t n_, const float *x_)
+{
+  svfloat64_t tot = svdup_n_f64(0.0);
+  for(uint64_t i = 0 ; i < n_ ; i += svcntw()) {
+    svbool_t pg = svwhilelt_b32_u64(i, n_);
+    svfloat32_t a = svld1_gather_u32index_f32(pg, x_, svld1_u32(pg, splitVarID_ + i));
+    svbool_t right = cmp_nle(pg, a, svld1_f32(pg, splitValue_ + i));
+    tot = widen_add(tot, pg, svsel_f32(right, svld1_f32(pg, right_ + i), svld1_f32(pg, left_ + i)));
+  }
+  return svaddv_f64(svptrue_b64(), tot);
+}
+
+double rf_sum_soa_sve(const uint32_t *a_, const uint32_t *c_, const uint32_t *e_,
+		      const float *b_, const float *d_, const float *f_,
+		      const float *one_, const float *two_, const float *three_, const float *four_,
+		      size_t n_, const float *x_)
+{
+  svfloat64_t tot = svdup_n_f64(0.0);
+  for(uint64_t i = 0 ; i < n_ ; i += svcntw()) {
+    svbool_t pg = svwhilelt_b32_u64(i, n_);
+    svbool_t m1 = cmp_nle(pg, svld1_gather_u32index_f32(pg, x_, svld1_u32(pg, a_ + i)), svld1_f32(pg, b_ + i));
+    svbool_t m2 = cmp_nle(pg, svld1_gather_u32index_f32(pg, x_, svld1_u32(pg, c_ + i)), svld1_f32(pg, d_ + i));
+    svbool_t m3 = cmp_nle(pg, svld1_gather_u32index_f32(pg, x_, svld1_u32(pg, e_ + i)), svld1_f32(pg, f_ + i));
+
+    svfloat32_t left = svsel_f32(m2, svld1_f32(pg, two_ + i), svld1_f32(pg, one_ + i));
+    svfloat32_t right = svsel_f32(m3, svld1_f32(pg, four_ + i), svld1_f32(pg, three_ + i));
+    tot = widen_add(tot, pg, svsel_f32(m1, right, left));
+  }
+  return svaddv_f64(svptrue_b64(), tot);
+}
+
+#endif
@@ -0,0 +1,136 @@
+//
+// a hot swappable model, published rcu style
+//
+// readers (the scoring path) never lock and never see a model go away under them, and a writer can load a
+// new model in the background and swap it in at any time:
+//
+// - the current model sits behind an atomic pointer
+// - readers announce themselves in one of two counters, picked by the parity of a global epoch, before
+//   loading the pointer, and leave when they're done scoring
+// - a writer swaps the pointer, bumps the epoch (so new readers use the other counter), waits for the old
+//   counter to drain, and only then deletes the old model
+//
+// a reader that races with the epoch bump notices (the epoch changed under it) and re-announces itself in
+// the new counter, so the two counters are all the bookkeeping there is.  writers are serialized with a
+// mutex, readers never touch it
+//
+// note: the counters are shared by every reader, which is noise next to a forest evaluation (hundreds of
+// microseconds) but would want sharding for much cheaper models
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "cpu.h"
+
+template<typename Model>
+class model_handle {
+  // a published model and its version
+  struct entry {
+    std::unique_ptr<Model> model;
+    uint64_t version;
+  };
+
+public:
+  model_handle() = default;
+  explicit model_handle(std::unique_ptr<Model> m_) : current(new entry{std::move(m_), 1}), published(1) {}
+
+  ~model_handle() {
+    delete current.load();
+  }
+
+  model_handle(const model_handle &) = delete;
+  model_handle &operator=(const model_handle &) = delete;
+
+  // a reader's view of the current model, which stays alive at least as long as the guard does
+  class guard {
+  public:
+    guard(guard &&o_) : h(o_.h), parity(o_.parity), e(o_.e) { o_.h = nullptr; }
+    ~guard() {
+      if(h) {
+	h->active[parity].count.fetch_sub(1, std::memory_order_release);
+      }
+    }
+
+    guard(const guard &) = delete;
+    guard &operator=(const guard &) = delete;
+
+    const Model *get() const { return e ? e->model.get() : nullptr; } // null if nothing was ever published
+    const Model &operator*() const { return *e->model; }
+    const Model *operator->() const { return e->model.get(); }
+    uint64_t version() const { return e ? e->version : 0; }
+
+  private:
+    friend class model_handle;
+    guard(const model_handle *h_, size_t parity_, const entry *e_) : h(h_), parity(parity_), e(e_) {}
+
+    const model_handle *h;
+    size_t parity;
+    const entry *e;
+  };
+
+  // pin the current model, lock free
+  guard acquire() const {
+    for(;;) {
+      uint64_t e = epoch.load();
+      size_t p = e & 1;
+      active[p].count.fetch_add(1);
+      if(epoch.load() == e) {
+	return guard(this, p, current.load());
+      }
+      active[p].count.fetch_sub(1); // raced with a publish, go again in the new epoch's counter
+    }
+  }
+
+  // f_(model) on the current model
+  template<typename FUNC>
+  auto with(FUNC f_) const {
+    guard g = acquire();
+    return f_(*g);
+  }
+
+  // swap in m_, returning once no reader can still be using the old model (which is then deleted)
+  void publish(std::unique_ptr<Model> m_) {
+    std::lock_guard<std::mutex> lock(writer);
+    entry *old = current.exchange(new entry{std::move(m_), published.fetch_add(1) + 1});
+    uint64_t e = epoch.fetch_add(1);
+
+    // readers counted under the old parity may hold old, wait for them to leave
+    for(size_t spin = 0 ; active[e & 1].count.load(std::memory_order_acquire) != 0 ; ++spin) {
+      if(spin < 1000) {
+	cpu_relax();
+      } else {
+	std::this_thread::yield();
+      }
+    }
+    delete old;
+  }
+
+  // run loader_ on a background thread and publish what it returns, the old model keeps serving until then
+  // (an exception from loader_ comes out of the future and leaves the current model in place)
+  std::future<void> publish_async(std::function<std::unique_ptr<Model>()> loader_) {
+    return std::async(std::launch::async, [this, loader_]() { publish(loader_()); });
+  }
+
+  // number of models published so far
+  uint64_t version() const { return published.load(); }
+
+private:
+  struct alignas(64) counter {
+    std::atomic<int64_t> count{0};
+  };
+
+  std::atomic<entry *> current{nullptr};
+  std::atomic<uint64_t> published{0};
+  alignas(64) std::atomic<uint64_t> epoch{0};
+  mutable counter active[2];
+  std::mutex writer;
+};
@@ -0,0 +1,129 @@
+//
+// multi-output depth-2 forests (see multi_output.h)
+//
+
+#include "multi_output.h"
+
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+multi_forest2::multi_forest2(size_t outputs_)
+  : outputs(outputs_), padded_outputs((outputs_ + 7) & ~(size_t)7)
+{
+  if(outputs_ == 0 || outputs_ > MULTI_MAX_OUTPUTS) {
+    throw std::invalid_argument("multi_forest2 supports 1 to " + std::to_string(MULTI_MAX_OUTPUTS) + " outputs, not " +
+				std::to_string(outputs_));
+  }
+}
+
+void multi_forest2::push_back(const tree2 &t_, const float *leaves_)
+{
+  // start a new group of 8 padding trees (leaves all 0) when the current one is full
+  if(size == a_splitVarID.size()) {
+    a_splitVarID.resize(size + 8, 0);
+    c_splitVarID.resize(size + 8, 0);
+    e_splitVarID.resize(size + 8, 0);
+    b_splitValue.resize(size + 8, 0.0f);
+    d_splitValue.resize(size + 8, 0.0f);
+    f_splitValue.resize(size + 8, 0.0f);
+    leaves.resize((size + 8) * 4 * padded_outputs, 0.0f);
+  }
+
+  a_splitVarID[size] = t_.a_splitVarID;
+  c_splitVarID[size] = t_.c_splitVarID;
+  e_splitVarID[size] = t_.e_splitVarID;
+  b_splitValue[size] = t_.b_splitValue;
+  d_splitValue[size] = t_.d_splitValue;
+  f_splitValue[size] = t_.f_splitValue;
+  for(size_t l = 0 ; l < 4 ; ++l) {
+    for(size_t k = 0 ; k < outputs ; ++k) {
+      leaves[(size * 4 + l) * padded_outputs + k] = leaves_[l * outputs + k];
+    }
+  }
+  ++size;
+}
+
+#if defined(__x86_64__)
+
+// V ymm registers of outputs (V * 8 = padded_outputs), kept in registers across the group
+template<size_t V>
+static void rf_sum_multi_avx2(const multi_forest2 &f_, const float *x_, double *out_)
+{
+  __m256d tot[2 * V];
+  for(size_t v = 0 ; v < 2 * V ; ++v) {
+    tot[v] = _mm256_setzero_pd();
+  }
+
+  for(size_t i = 0 ; i < f_.a_splitVarID.size() ; i += 8) {
+    __m256 xa = _mm256_i32gather_ps(x_, _mm256_load_si256((const __m256i *)&f_.a_splitVarID[i]), 4);
+    __m256 xc = _mm256_i32gather_ps(x_, _mm256_load_si256((const __m256i *)&f_.c_splitVarID[i]), 4);
+    __m256 xe = _mm256_i32gather_ps(x_, _mm256_load_si256((const __m256i *)&f_.e_splitVarID[i]), 4);
+
+    // !(<=) like rf_sum_soa, so a set bit means right and NaNs go right
+    unsigned m1 = _mm256_movemask_ps(_mm256_cmp_ps(xa, _mm256_load_ps(&f_.b_splitValue[i]), _CMP_NLE_UQ));
+    unsigned m2 = _mm256_movemask_ps(_mm256_cmp_ps(xc, _mm256_load_ps(&f_.d_splitValue[i]), _CMP_NLE_UQ));
+    unsigned m3 = _mm256_movemask_ps(_mm256_cmp_ps(xe, _mm256_load_ps(&f_.f_splitValue[i]), _CMP_NLE_UQ));
+
+    __m256 grp[V];
+    for(size_t v = 0 ; v < V ; ++v) {
+      grp[v] = _mm256_setzero_ps();
+    }
+    for(size_t l = 0 ; l < 8 ; ++l) {
+      unsigned leaf = (m1 >> l) & 1 ? 2 + ((m3 >> l) & 1) : (m2 >> l) & 1;
+      const float *p = &f_.leaves[((i + l) * 4 + leaf) * V * 8];
+      for(size_t v = 0 ; v < V ; ++v) {
+	grp[v] = _mm256_add_ps(grp[v], _mm256_load_ps(p + v * 8));
+      }
+    }
+
+    for(size_t v = 0 ; v < V ; ++v) {
+      tot[2 * v] = _mm256_add_pd(tot[2 * v], _mm256_cvtps_pd(_mm256_castps256_ps128(grp[v])));
+      tot[2 * v + 1] = _mm256_add_pd(tot[2 * v + 1], _mm256_cvtps_pd(_mm256_extractf128_ps(grp[v], 1)));
+    }
+  }
+
+  alignas(32) double all[V * 8];
+  for(size_t v = 0 ; v < 2 * V ; ++v) {
+    _mm256_store_pd(all + v * 4, tot[v]);
+  }
+  for(size_t k = 0 ; k < f_.outputs ; ++k) {
+    out_[k] = all[k];
+  }
+}
+
+void rf_sum_multi(const multi_forest2 &f_, const float *x_, double *out_)
+{
+  switch(f_.padded_outputs / 8) {
+  case 1:
+    return rf_sum_multi_avx2<1>(f_, x_, out_);
+  case 2:
+    return rf_sum_multi_avx2<2>(f_, x_, out_);
+  case 3:
+    return rf_sum_multi_avx2<3>(f_, x_, out_);
+  default:
+    return rf_sum_multi_avx2<4>(f_, x_, out_);
+  }
+}
+
+#else
+
+void rf_sum_multi(const multi_forest2 &f_, const float *x_, double *out_)
+{
+  for(size_t k = 0 ; k < f_.outputs ; ++k) {
+    out_[k] = 0.0;
+  }
+  for(size_t i = 0 ; i < f_.size ; ++i) {
+    size_t leaf = !(x_[f_.a_splitVarID[i]] <= f_.b_splitValue[i]) ?
+      2 + !(x_[f_.e_splitVarID[i]] <= f_.f_splitValue[i]) : !(x_[f_.c_splitVarID[i]] <= f_.d_splitValue[i]);
+    const float *p = &f_.leaves[(i * 4 + leaf) * f_.padded_outputs];
+    for(size_t k = 0 ; k < f_.outputs ; ++k) {
+      out_[k] += p[k];
+    }
+  }
+}
+
+#endif
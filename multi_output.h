@@ -0,0 +1,51 @@
+//
+// depth-2 forests whose leaves are vectors (multi-class probabilities, multi-output regression)
+//
+// the splits are stored like forest2_soa and evaluated 8 trees at a time the same way, but instead of
+// blending 8 scalar leaves we turn the three masks into each tree's leaf index and add that leaf's whole
+// vector with simd adds across the outputs.  the splits are read once for all K outputs, where K scalar
+// forests would read them K times
+//
+// a leaf vector is padded with zeros to a multiple of 8 floats so each one is a few aligned ymm loads, and
+// each group of 8 trees is summed in float before being added to the double totals.  stumps fit too, as
+// depth-2 trees whose two children split the same way
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "aligned.h"
+#include "forest.h"
+
+// widest leaf vectors supported
+const size_t MULTI_MAX_OUTPUTS = 32;
+
+struct multi_forest2 {
+  aligned_vector<uint32_t> a_splitVarID, c_splitVarID, e_splitVarID;
+  aligned_vector<float> b_splitValue, d_splitValue, f_splitValue;
+  aligned_vector<float> leaves;     // (tree * 4 + leaf) * padded_outputs, leaf 0..3 = one, two, three, four
+  size_t outputs;                   // K
+  size_t padded_outputs;            // K rounded up to a multiple of 8
+  size_t size = 0;
+
+  // throws std::invalid_argument for 0 or more than MULTI_MAX_OUTPUTS outputs
+  explicit multi_forest2(size_t outputs_);
+
+  // the splits of t_ (its scalar leaves are ignored) with leaves_ = 4 * outputs floats, one's vector first
+  void push_back(const tree2 &t_, const float *leaves_);
+};
+
+// per-output sums of the tree predictions for sample x_, out_ receives outputs values
+void rf_sum_multi(const multi_forest2 &f_, const float *x_, double *out_);
+
+// per-output averages
+inline void rf_eval_multi(const multi_forest2 &f_, const float *x_, double *out_)
+{
+  rf_sum_multi(f_, x_, out_);
+  for(size_t k = 0 ; k < f_.outputs ; ++k) {
+    out_[k] /= f_.size;
+  }
+}
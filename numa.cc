@@ -0,0 +1,122 @@
+//
+// cpu / numa node topology (see numa.h)
+//
+
+#include "numa.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+// parse a kernel cpu list like "0-3,8,10-11"
+static std::vector<int> parse_cpulist(const std::string &s_)
+{
+  std::vector<int> out;
+  std::stringstream ss(s_);
+  std::string range;
+  while(std::getline(ss, range, ',')) {
+    if(range.empty() || range == "\n") {
+      continue;
+    }
+    size_t dash = range.find('-');
+    int lo = std::stoi(range.substr(0, dash));
+    int hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+    for(int c = lo ; c <= hi ; ++c) {
+      out.push_back(c);
+    }
+  }
+  return out;
+}
+
+size_t cpu_topology::nodes() const
+{
+  std::vector<int> n = node;
+  std::sort(n.begin(), n.end());
+  return std::unique(n.begin(), n.end()) - n.begin();
+}
+
+cpu_topology get_topology()
+{
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+
+  std::map<int, int> cpu_node;
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string nodes;
+  if(std::getline(online, nodes)) {
+    for(int n : parse_cpulist(nodes)) {
+      std::ifstream f("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+      std::string cpus;
+      if(std::getline(f, cpus)) {
+	for(int c : parse_cpulist(cpus)) {
+	  cpu_node[c] = n;
+	}
+      }
+    }
+  }
+
+  cpu_topology t;
+  std::vector<std::pair<int, int>> order; // (node, cpu)
+  for(int c = 0 ; c < CPU_SETSIZE ; ++c) {
+    if(CPU_ISSET(c, &allowed)) {
+      auto it = cpu_node.find(c);
+      order.push_back({ it == cpu_node.end() ? 0 : it->second, c });
+    }
+  }
+  std::sort(order.begin(), order.end());
+  for(auto [n, c] : order) {
+    t.cpus.push_back(c);
+    t.node.push_back(n);
+  }
+  return t;
+}
+
+cpu_topology without_cpu(const cpu_topology &t_, int cpu_)
+{
+  cpu_topology out;
+  for(size_t i = 0 ; i < t_.cpus.size() ; ++i) {
+    if(t_.cpus[i] != cpu_) {
+      out.cpus.push_back(t_.cpus[i]);
+      out.node.push_back(t_.node[i]);
+    }
+  }
+  return out;
+}
+
+std::vector<int> pick_cpus(const cpu_topology &t_, size_t threads_)
+{
+  // bucket the cpus by node, then deal them out one node at a time
+  std::map<int, std::vector<int>> by_node;
+  for(size_t i = 0 ; i < t_.cpus.size() ; ++i) {
+    by_node[t_.node[i]].push_back(t_.cpus[i]);
+  }
+
+  std::vector<int> dealt;
+  for(size_t round = 0 ; dealt.size() < t_.cpus.size() ; ++round) {
+    for(auto &[n, cpus] : by_node) {
+      if(round < cpus.size()) {
+	dealt.push_back(cpus[round]);
+      }
+    }
+  }
+
+  std::vector<int> out;
+  for(size_t i = 0 ; i < threads_ && !dealt.empty() ; ++i) {
+    out.push_back(dealt[i % dealt.size()]);
+  }
+  return out;
+}
+
+bool pin_thread(int cpu_)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu_, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
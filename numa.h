@@ -0,0 +1,32 @@
+//
+// cpu / numa node topology helpers for the parallel evaluators
+//
+// the topology comes from /sys/devices/system/node and is restricted to the cpus this process is allowed
+// to run on.  no libnuma: memory is placed on a node by first touching it from a thread pinned to one
+// of that node's cpus (the default linux policy)
+//
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+struct cpu_topology {
+  std::vector<int> cpus;   // allowed cpus, grouped by node
+  std::vector<int> node;   // node[i] is the numa node of cpus[i]
+
+  size_t nodes() const;
+};
+
+// the allowed cpus of this process (a single node 0 if the system doesn't report any numa information)
+cpu_topology get_topology();
+
+// t_ less cpu_ (unchanged if cpu_ isn't one of its cpus)
+cpu_topology without_cpu(const cpu_topology &t_, int cpu_);
+
+// threads_ cpus to run shards on, taken round robin from the nodes so every node's memory bandwidth is used
+// (cpus are reused if threads_ is more than the number of allowed cpus)
+std::vector<int> pick_cpus(const cpu_topology &t_, size_t threads_);
+
+// pin the calling thread to cpu_, returns false if that isn't allowed
+bool pin_thread(int cpu_);
@@ -0,0 +1,96 @@
+//
+// multithreaded forest evaluation (see parallel.h)
+//
+
+#include "parallel.h"
+
+#include <algorithm>
+
+// [begin, end) of shard i_ out of shards_ for count_ items, shard boundaries on multiples of 8
+static std::pair<size_t, size_t> shard_range(size_t count_, size_t shards_, size_t i_)
+{
+  size_t per = ((count_ + shards_ - 1) / shards_ + 7) & ~size_t(7);
+  return { std::min(count_, i_ * per), std::min(count_, (i_ + 1) * per) };
+}
+
+template<typename F>
+static sharded_forest<F> make_shards(size_t count_, const worker_pool &pool_)
+{
+  // no point in shards with less than a register's worth of trees
+  size_t shards = std::max<size_t>(1, std::min(pool_.size(), (count_ + 7) / 8));
+
+  sharded_forest<F> out;
+  out.shards.resize(shards);
+  out.size = count_;
+  return out;
+}
+
+sharded_forest<forest2_soa> shard_forest2(const forest2 &f_, worker_pool &pool_)
+{
+  auto out = make_shards<forest2_soa>(f_.size(), pool_);
+  pool_.run_wait(out.shards.size(), [&](size_t i_) {
+    auto [begin, end] = shard_range(f_.size(), out.shards.size(), i_);
+    forest2_soa shard;
+    for(size_t t = begin ; t < end ; ++t) {
+      shard.push_back(f_[t]);
+    }
+    out.shards[i_] = std::move(shard);
+  });
+  return out;
+}
+
+sharded_forest<stump_forest> shard_stumps(const stump_forest &f_, worker_pool &pool_)
+{
+  auto out = make_shards<stump_forest>(f_.size, pool_);
+  pool_.run_wait(out.shards.size(), [&](size_t i_) {
+    auto [begin, end] = shard_range(f_.size, out.shards.size(), i_);
+    stump_forest shard;
+    for(size_t t = begin ; t < end ; ++t) {
+      shard.push_back(f_.splitVarID[t], f_.splitValue[t], f_.left[t], f_.right[t]);
+    }
+    out.shards[i_] = std::move(shard);
+  });
+  return out;
+}
+
+template<typename F, typename SUM>
+static double parallel_eval(const sharded_forest<F> &f_, worker_pool &pool_, SUM sum_)
+{
+  // one partial per cache line so the workers don't fight over them
+  struct alignas(64) partial_sum { double v; };
+  std::vector<partial_sum> partial(f_.shards.size());
+
+  if(f_.shards.size() == 1) {
+    partial[0].v = sum_(f_.shards[0]);
+  } else {
+    pool_.run(f_.shards.size(), [&](size_t i_) { partial[i_].v = sum_(f_.shards[i_]); });
+  }
+
+  double total = 0.0;
+  for(const auto &p : partial) {
+    total += p.v;
+  }
+  return total / f_.size;
+}
+
+double rf_eval_parallel(const sharded_forest<forest2_soa> &f_, const float *x_, worker_pool &pool_)
+{
+  return parallel_eval(f_, pool_, [&](const forest2_soa &s_) { return rf_sum_soa(s_.view(), x_); });
+}
+
+double rf_eval_parallel(const sharded_forest<stump_forest> &f_, const float *x_, worker_pool &pool_)
+{
+  return parallel_eval(f_, pool_, [&](const stump_forest &s_) { return rf_sum_stumps(s_, x_); });
+}
+
+void rf_eval_parallel_batch(const forest2_soa &f_, const float *x_, size_t rows_, size_t num_preds_, double *out,
+			    worker_pool &pool_)
+{
+  const size_t CHUNK = 4; // rows per hand out, small enough to balance, large enough to amortize the atomic
+  auto v = f_.view();
+  pool_.parallel_for((rows_ + CHUNK - 1) / CHUNK, [&](size_t c_) {
+    for(size_t r = c_ * CHUNK ; r < std::min(rows_, (c_ + 1) * CHUNK) ; ++r) {
+      out[r] = rf_eval_soa(v, x_ + r * num_preds_);
+    }
+  });
+}
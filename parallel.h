@@ -0,0 +1,42 @@
+//
+// multithreaded forest evaluation
+//
+// the forest is split into contiguous shards, one per worker of a worker_pool (see pool.h), whose workers
+// are pinned to cpus dealt round robin across the numa nodes (see numa.h).  shard i is built by worker i,
+// so its pages are first touched (and allocated) on that worker's numa node, and it is always evaluated
+// by that same worker, so each thread streams memory local to it.  building waits for a busy pool (see
+// run_wait), so don't shard from inside one of the pool's tasks
+//
+// each shard produces a partial sum and the partial sums are added in shard order, so the result only
+// depends on the number of shards and never on thread timing
+//
+
+#pragma once
+
+#include <vector>
+
+#include "forest.h"
+#include "forest_soa.h"
+#include "pool.h"
+#include "stumps.h"
+
+template<typename F>
+struct sharded_forest {
+  std::vector<F> shards;   // shard i lives on (and is evaluated by) worker i of the pool it was built with
+  size_t size = 0;         // total number of trees
+};
+
+// split f_ across the workers of pool_
+sharded_forest<forest2_soa> shard_forest2(const forest2 &f_, worker_pool &pool_ = default_pool());
+
+sharded_forest<stump_forest> shard_stumps(const stump_forest &f_, worker_pool &pool_ = default_pool());
+
+// average prediction for sample x_, every shard evaluated by its own worker (pool_ must be the pool f_ was built with)
+double rf_eval_parallel(const sharded_forest<forest2_soa> &f_, const float *x_, worker_pool &pool_ = default_pool());
+
+double rf_eval_parallel(const sharded_forest<stump_forest> &f_, const float *x_, worker_pool &pool_ = default_pool());
+
+// request level parallelism: score rows_ row-major samples (num_preds_ predictors each) against f_, handing out
+// chunks of rows to whichever worker is free.  out receives rf_eval_soa's result for each row
+void rf_eval_parallel_batch(const forest2_soa &f_, const float *x_, size_t rows_, size_t num_preds_, double *out,
+			    worker_pool &pool_ = default_pool());
@@ -0,0 +1,174 @@
+//
+// perf_event_open counters (see perf.h)
+//
+
+#include "perf.h"
+
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+const char *perf_event_name(perf_event_id e_)
+{
+  switch(e_) {
+  case PERF_CYCLES:
+    return "cycles";
+  case PERF_INSTRUCTIONS:
+    return "instructions";
+  case PERF_LLC_MISSES:
+    return "llc misses";
+  case PERF_DTLB_MISSES:
+    return "dtlb misses";
+  case PERF_TASK_CLOCK:
+    return "task clock ns";
+  default:
+    return "unknown";
+  }
+}
+
+static void describe(perf_event_id e_, perf_event_attr &a_)
+{
+  memset(&a_, 0, sizeof(a_));
+  a_.size = sizeof(a_);
+  a_.exclude_kernel = 1;  // all perf_event_paranoid=2 allows, and the kernels never enter the kernel anyway
+  a_.exclude_hv = 1;
+  a_.read_format = PERF_FORMAT_GROUP;
+  switch(e_) {
+  case PERF_CYCLES:
+    a_.type = PERF_TYPE_HARDWARE;
+    a_.config = PERF_COUNT_HW_CPU_CYCLES;
+    break;
+  case PERF_INSTRUCTIONS:
+    a_.type = PERF_TYPE_HARDWARE;
+    a_.config = PERF_COUNT_HW_INSTRUCTIONS;
+    break;
+  case PERF_LLC_MISSES:
+    a_.type = PERF_TYPE_HARDWARE;
+    a_.config = PERF_COUNT_HW_CACHE_MISSES;
+    break;
+  case PERF_DTLB_MISSES:
+    a_.type = PERF_TYPE_HW_CACHE;
+    a_.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    break;
+  default:
+    break;
+  }
+}
+
+perf_counters::perf_counters()
+{
+  for(size_t e = 0 ; e < PERF_EVENTS ; ++e) {
+    fd[e] = slot[e] = -1;
+    page[e] = nullptr;
+  }
+  const long PAGE = sysconf(_SC_PAGESIZE);
+  for(int e = 0 ; e < PERF_TASK_CLOCK ; ++e) {
+    perf_event_attr a;
+    describe((perf_event_id)e, a);
+    int f = syscall(SYS_perf_event_open, &a, 0, -1, leader, 0);
+    if(f < 0) {
+      if(why.empty()) {
+	why = std::string(perf_event_name((perf_event_id)e)) + ": " + strerror(errno);
+      }
+      continue;
+    }
+    if(leader < 0) {
+      leader = f;
+    }
+    fd[e] = f;
+    slot[e] = opened++;
+    void *p = mmap(nullptr, PAGE, PROT_READ, MAP_SHARED, f, 0);
+    page[e] = p == MAP_FAILED ? nullptr : p;
+  }
+}
+
+perf_counters::~perf_counters()
+{
+  const long PAGE = sysconf(_SC_PAGESIZE);
+  for(size_t e = 0 ; e < PERF_EVENTS ; ++e) {
+    if(page[e]) {
+      munmap(page[e], PAGE);
+    }
+    if(fd[e] >= 0) {
+      close(fd[e]);
+    }
+  }
+}
+
+bool perf_counters::hardware() const
+{
+  return opened > 0;
+}
+
+#if defined(__x86_64__)
+
+// the user space read described in perf_event_open(2): retry if the kernel rescheduled the counter meanwhile
+static bool read_mapped(const volatile perf_event_mmap_page *pc_, uint64_t &out_)
+{
+  uint32_t seq;
+  uint64_t count;
+  do {
+    seq = pc_->lock;
+    asm volatile("" ::: "memory");
+    uint32_t idx = pc_->index;
+    if(!pc_->cap_user_rdpmc || idx == 0) {
+      return false;
+    }
+    count = pc_->offset;
+    int shift = 64 - pc_->pmc_width;
+    count += (int64_t)((uint64_t)__rdpmc(idx - 1) << shift) >> shift;
+    asm volatile("" ::: "memory");
+  } while(pc_->lock != seq);
+  out_ = count;
+  return true;
+}
+
+bool perf_counters::read_direct(perf_sample &out_) const
+{
+  for(size_t e = 0 ; e < PERF_TASK_CLOCK ; ++e) {
+    if(fd[e] < 0) {
+      continue;
+    }
+    if(!page[e] || !read_mapped((const volatile perf_event_mmap_page *)page[e], out_.value[e])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#else
+
+bool perf_counters::read_direct(perf_sample &) const
+{
+  return false;
+}
+
+#endif
+
+perf_sample perf_counters::read() const
+{
+  perf_sample s;
+  if(opened > 0 && !read_direct(s)) {
+    uint64_t buf[1 + PERF_EVENTS] = {};
+    if(::read(leader, buf, sizeof(buf)) > 0) {
+      for(size_t e = 0 ; e < PERF_TASK_CLOCK ; ++e) {
+	if(slot[e] >= 0 && (uint64_t)slot[e] < buf[0]) {
+	  s.value[e] = buf[1 + slot[e]];
+	}
+      }
+    }
+  }
+  timespec tp;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &tp);
+  s.value[PERF_TASK_CLOCK] = static_cast<uint64_t>(tp.tv_sec) * 1000 * 1000 * 1000 + static_cast<uint64_t>(tp.tv_nsec);
+  return s;
+}
@@ -0,0 +1,96 @@
+//
+// hardware performance counters around the kernels, via perf_event_open
+//
+// a perf_counters opens cycles, instructions, last level cache misses and dTLB misses (user space only, for
+// the calling thread) as one group so they're all read at once, and adds the thread's cpu time (the task
+// clock, from CLOCK_THREAD_CPUTIME_ID so it works without a pmu).  without them a kernel being 6x rather
+// than 8x faster than the scalar code is just a number; the counters tell whether it's waiting on memory
+// (llc misses x 64 bytes against the time), on page walks (dtlb) or executing slowly (instructions per
+// cycle)
+//
+// reading is meant to be cheap enough for a production evaluator to bracket every batch: when the kernel
+// lets user space read the counters directly (cap_user_rdpmc, x86) a read is a few rdpmc instructions,
+// otherwise it's one read() of the group
+//
+// counters the kernel, hypervisor or perf_event_paranoid won't give us are left out rather than failing,
+// available() says which ones we got (in many vms that's only the task clock)
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum perf_event_id { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_LLC_MISSES, PERF_DTLB_MISSES, PERF_TASK_CLOCK, PERF_EVENTS };
+
+const char *perf_event_name(perf_event_id e_);
+
+// counts of every event, zero for the ones that aren't available
+struct perf_sample {
+  uint64_t value[PERF_EVENTS] = {};
+
+  uint64_t operator[](perf_event_id e_) const { return value[e_]; }
+
+  // bytes brought in from memory, one line per last level cache miss
+  uint64_t bytes() const { return value[PERF_LLC_MISSES] * 64; }
+  double ipc() const { return value[PERF_CYCLES] ? (double)value[PERF_INSTRUCTIONS] / value[PERF_CYCLES] : 0.0; }
+
+  perf_sample operator-(const perf_sample &o_) const {
+    perf_sample d;
+    for(size_t i = 0 ; i < PERF_EVENTS ; ++i) {
+      d.value[i] = value[i] - o_.value[i];
+    }
+    return d;
+  }
+  perf_sample &operator+=(const perf_sample &o_) {
+    for(size_t i = 0 ; i < PERF_EVENTS ; ++i) {
+      value[i] += o_.value[i];
+    }
+    return *this;
+  }
+};
+
+class perf_counters {
+public:
+  perf_counters();
+  ~perf_counters();
+
+  perf_counters(const perf_counters &) = delete;
+  perf_counters &operator=(const perf_counters &) = delete;
+
+  bool available(perf_event_id e_) const { return e_ == PERF_TASK_CLOCK || fd[e_] >= 0; }
+  // whether any of the hardware events (everything but the task clock) opened
+  bool hardware() const;
+  // why the first hardware event failed to open, if it did
+  const std::string &error() const { return why; }
+
+  // totals since construction (only differences between two reads mean anything); must be called on the
+  // thread that constructed this
+  perf_sample read() const;
+
+private:
+  int fd[PERF_EVENTS];                    // -1 if not open (always for the task clock)
+  int slot[PERF_EVENTS];                  // position of each event in the group read
+  void *page[PERF_EVENTS];                // the mmap'd perf_event_mmap_page of each event, for rdpmc
+  size_t opened = 0;
+  int leader = -1;
+  std::string why;
+
+  bool read_direct(perf_sample &out_) const;
+};
+
+// adds the counts of everything that happens during its lifetime to total_
+class perf_scope {
+public:
+  perf_scope(const perf_counters &c_, perf_sample &total_) : c(c_), total(total_), start(c_.read()) {}
+  ~perf_scope() { total += c.read() - start; }
+
+  perf_scope(const perf_scope &) = delete;
+  perf_scope &operator=(const perf_scope &) = delete;
+
+private:
+  const perf_counters &c;
+  perf_sample &total;
+  perf_sample start;
+};
@@ -0,0 +1,175 @@
+//
+// persistent worker pool (see pool.h)
+//
+
+#include "pool.h"
+
+#include <sched.h>
+
+#include "cpu.h"
+#include "numa.h"
+
+// spin until done_() or spin_ has passed, returns done_().  the clock is only read every few pauses, a
+// pause is anything from a few to over a hundred cycles depending on the cpu
+template<typename DONE>
+static bool spin_for(std::chrono::nanoseconds spin_, DONE done_)
+{
+  const auto until = std::chrono::steady_clock::now() + spin_;
+  for(size_t s = 1 ; !done_() ; ++s) {
+    cpu_relax();
+    if(s % 16 == 0 && std::chrono::steady_clock::now() >= until) {
+      return done_();
+    }
+  }
+  return true;
+}
+
+worker_pool::worker_pool(const std::vector<int> &cpus_, std::chrono::nanoseconds spin_)
+  : cpu_list(cpus_), spin(spin_)
+{
+  for(size_t i = 0 ; i < cpu_list.size() ; ++i) {
+    threads.emplace_back([this, i]() { worker(i); });
+  }
+}
+
+worker_pool::~worker_pool()
+{
+  stop = true;
+  epoch.fetch_add(2, std::memory_order_release);
+  epoch.notify_all();
+  for(auto &t : threads) {
+    t.join();
+  }
+}
+
+void worker_pool::worker(size_t id_)
+{
+  pin_thread(cpu_list[id_]);
+
+  uint32_t seen = 1;
+  while(true) {
+    // spin, then park, until the epoch moves
+    uint32_t e = seen;
+    if(!spin_for(spin, [&]() { return (e = epoch.load(std::memory_order_acquire)) != seen; })) {
+      epoch.wait(seen, std::memory_order_acquire);
+      continue;
+    }
+    seen = e;
+    if(stop) {
+      return;
+    }
+    if(e & 1) {
+      continue;
+    }
+
+    // the job may have been finished (and the next one be being written) since we saw it, so announce
+    // ourselves and only then check it's still open.  dispatch closes the epoch before it waits for
+    // active, so one of the two sees the other
+    active.fetch_add(1, std::memory_order_seq_cst);
+    if(epoch.load(std::memory_order_seq_cst) == e) {
+      size_t done = 0;
+      if(job_dynamic) {
+	for(size_t i = next.fetch_add(1, std::memory_order_relaxed) ; i < job_size ; i = next.fetch_add(1, std::memory_order_relaxed)) {
+	  (*job)(i);
+	  ++done;
+	}
+      } else {
+	for(size_t i = id_ ; i < job_size ; i += threads.size()) {
+	  (*job)(i);
+	  ++done;
+	}
+      }
+      if(done != 0 && pending.fetch_sub(done, std::memory_order_acq_rel) == done) {
+	pending.notify_one();
+      }
+    }
+    active.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+void worker_pool::dispatch(size_t n_, const std::function<void(size_t)> &fn_, bool dynamic_, bool wait_)
+{
+  if(n_ == 0) {
+    return;
+  }
+  bool taken = !threads.empty() && !busy.exchange(true, std::memory_order_acquire);
+  if(!taken && !threads.empty() && wait_) {
+    // another thread's job has the pool, wait for it to close
+    auto take = [&]() { return !busy.load(std::memory_order_relaxed) && !busy.exchange(true, std::memory_order_acquire); };
+    if(!spin_for(spin, take)) {
+      while(!take()) {
+	std::this_thread::yield();
+      }
+    }
+    taken = true;
+  }
+  if(!taken) {
+    for(size_t i = 0 ; i < n_ ; ++i) {
+      fn_(i);
+    }
+    return;
+  }
+
+  // workers that got to the last job after it closed may still be looking at it
+  if(!spin_for(spin, [&]() { return active.load(std::memory_order_seq_cst) == 0; })) {
+    while(active.load(std::memory_order_seq_cst) != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  job = &fn_;
+  job_size = n_;
+  job_dynamic = dynamic_;
+  next.store(0, std::memory_order_relaxed);
+  pending.store(n_, std::memory_order_relaxed);
+  epoch.fetch_add(1, std::memory_order_release);
+  epoch.notify_all();
+
+  // the caller takes its share of dynamic jobs
+  if(dynamic_) {
+    size_t done = 0;
+    for(size_t i = next.fetch_add(1, std::memory_order_relaxed) ; i < n_ ; i = next.fetch_add(1, std::memory_order_relaxed)) {
+      fn_(i);
+      ++done;
+    }
+    if(done != 0) {
+      pending.fetch_sub(done, std::memory_order_acq_rel);
+    }
+  }
+
+  // join: spin, then park, until every task has run
+  if(!spin_for(spin, [&]() { return pending.load(std::memory_order_acquire) == 0; })) {
+    for(size_t p = pending.load(std::memory_order_acquire) ; p != 0 ; p = pending.load(std::memory_order_acquire)) {
+      pending.wait(p, std::memory_order_acquire);
+    }
+  }
+
+  // close the job, back to odd
+  epoch.fetch_add(1, std::memory_order_seq_cst);
+  busy.store(false, std::memory_order_release);
+}
+
+void worker_pool::run(size_t n_, const std::function<void(size_t)> &fn_)
+{
+  dispatch(n_, fn_, false, false);
+}
+
+void worker_pool::run_wait(size_t n_, const std::function<void(size_t)> &fn_)
+{
+  dispatch(n_, fn_, false, true);
+}
+
+void worker_pool::parallel_for(size_t n_, const std::function<void(size_t)> &fn_)
+{
+  dispatch(n_, fn_, true, false);
+}
+
+worker_pool &default_pool()
+{
+  static worker_pool pool([]() {
+    // a worker sharing the caller's cpu would only ever run while the caller waits on it
+    cpu_topology topo = without_cpu(get_topology(), sched_getcpu());
+    return pick_cpus(topo, topo.cpus.size());
+  }());
+  return pool;
+}
@@ -0,0 +1,83 @@
+//
+// persistent worker pool for low latency fork/join
+//
+// a forest evaluation is well under a millisecond, so starting threads per call (or waking them through
+// a mutex/condition variable) would cost about as much as the work.  instead the workers are started
+// once, each pinned to its cpu, and a job is handed over without any lock:
+//
+// - the caller publishes the job and bumps an epoch counter (to even, odd means no job is open)
+// - idle workers spin on the epoch for a while (spin_, about 50us by default) and only then park on it
+//   with std::atomic::wait (a futex), so back to back jobs never go through the kernel
+// - a job is done when its tasks are: everyone who ran some counts them off a pending counter, and the
+//   caller spins on that the same way (spin, then wait) to join.  workers still asleep when the tasks
+//   ran out are not waited for, a late worker checks the epoch is still the job's before touching it,
+//   and the next job isn't written until such stragglers have left
+//
+// jobs come in two flavours:
+//
+// run(n, fn)          : fn(i) runs on worker i % size(), so task i always lands on the same cpu (used for
+//                       shards whose memory lives on that cpu's numa node)
+// run_wait(n, fn)     : run, but waits for a busy pool rather than running the job itself (for work whose
+//                       placement matters, like first touching a shard's memory on its worker's node)
+// parallel_for(n, fn) : fn(i) for i in [0, n) is handed out dynamically to the caller and whichever
+//                       worker is free, so a pool of n workers has n + 1 threads on the job
+//
+// only one job runs at a time.  a caller of run or parallel_for that finds the pool busy does not block,
+// it just runs its job itself on the calling thread, as does the caller of a pool without workers.  scores
+// come out the same either way, only the placement is lost.  run_wait blocks instead, so it must never be
+// called from inside one of the pool's own tasks
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// default time a worker (or a joining caller) spins before parking
+const std::chrono::nanoseconds POOL_SPIN = std::chrono::microseconds(50);
+
+class worker_pool {
+public:
+  // one worker per entry of cpus_, pinned to it
+  explicit worker_pool(const std::vector<int> &cpus_, std::chrono::nanoseconds spin_ = POOL_SPIN);
+  ~worker_pool();
+
+  worker_pool(const worker_pool &) = delete;
+  worker_pool &operator=(const worker_pool &) = delete;
+
+  size_t size() const { return threads.size(); }
+  const std::vector<int> &cpus() const { return cpu_list; }
+
+  void run(size_t n_, const std::function<void(size_t)> &fn_);
+  void run_wait(size_t n_, const std::function<void(size_t)> &fn_);
+  void parallel_for(size_t n_, const std::function<void(size_t)> &fn_);
+
+private:
+  void worker(size_t id_);
+  void dispatch(size_t n_, const std::function<void(size_t)> &fn_, bool dynamic_, bool wait_);
+
+  std::vector<int> cpu_list;
+  std::vector<std::thread> threads;
+  std::chrono::nanoseconds spin;
+
+  // the current job, written by the caller before epoch is bumped
+  const std::function<void(size_t)> *job = nullptr;
+  size_t job_size = 0;
+  bool job_dynamic = false;
+  bool stop = false;
+
+  alignas(64) std::atomic<uint32_t> epoch{1};
+  alignas(64) std::atomic<size_t> pending{0};   // tasks of the open job not yet finished
+  alignas(64) std::atomic<uint32_t> active{0};  // workers inside the open (or just closed) job
+  alignas(64) std::atomic<size_t> next{0};
+  alignas(64) std::atomic<bool> busy{false};
+};
+
+// process wide pool with a worker on every allowed cpu but the one the first caller is on (dealt round robin
+// across numa nodes), started on first use.  parallel_for's caller makes up the last thread
+worker_pool &default_pool();
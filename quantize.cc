@@ -0,0 +1,238 @@
+//
+// quantized split comparisons (see quantize.h)
+//
+
+#include "quantize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "simd.h"
+
+feature_bins::feature_bins(const forest2_soa &f_, size_t num_preds_)
+  : cuts(num_preds_)
+{
+  for(size_t i = 0 ; i < f_.size ; ++i) {
+    add(f_.a_splitVarID[i], f_.b_splitValue[i]);
+    add(f_.c_splitVarID[i], f_.d_splitValue[i]);
+    add(f_.e_splitVarID[i], f_.f_splitValue[i]);
+  }
+  finish();
+}
+
+void feature_bins::add(uint32_t splitVarID_, float splitValue_)
+{
+  if(splitVarID_ >= cuts.size()) {
+    throw std::invalid_argument("split on predictor " + std::to_string(splitVarID_) + " of " + std::to_string(cuts.size()));
+  }
+  if(std::isnan(splitValue_)) {
+    throw std::invalid_argument("NaN split value on predictor " + std::to_string(splitVarID_));
+  }
+  cuts[splitVarID_].push_back(splitValue_);
+}
+
+void feature_bins::finish()
+{
+  for(auto &c : cuts) {
+    std::sort(c.begin(), c.end());
+    c.erase(std::unique(c.begin(), c.end()), c.end());
+  }
+}
+
+size_t feature_bins::max_cuts() const
+{
+  size_t m = 0;
+  for(const auto &c : cuts) {
+    m = std::max(m, c.size());
+  }
+  return m;
+}
+
+uint32_t feature_bins::bin(uint32_t f_, float v_) const
+{
+  const auto &c = cuts[f_];
+  if(std::isnan(v_)) {
+    return c.size();
+  }
+  return std::lower_bound(c.begin(), c.end(), v_) - c.begin();
+}
+
+void feature_bins::quantize(const float *x_, int16_t *out_) const
+{
+  for(size_t f = 0 ; f < cuts.size() ; ++f) {
+    out_[f] = bin(f, x_[f]);
+  }
+  out_[cuts.size()] = 0;
+}
+
+quantized_soa::quantized_soa(const forest2_soa &f_, const feature_bins &bins_)
+  : size(f_.size)
+{
+  if(bins_.num_preds() > 65536) {
+    throw std::invalid_argument("more than 65536 predictors");
+  }
+  if(bins_.max_cuts() > (size_t)std::numeric_limits<int16_t>::max()) {
+    throw std::invalid_argument("more than 32767 distinct splits on one predictor");
+  }
+
+  size_t padded = (size + 15) & ~(size_t)15;
+  for(auto *v : {&a_splitVarID, &c_splitVarID, &e_splitVarID}) {
+    v->assign(padded, 0);
+  }
+  for(auto *v : {&b_splitBin, &d_splitBin, &f_splitBin}) {
+    v->assign(padded, 0);
+  }
+  for(auto *v : {&one, &two, &three, &four}) {
+    v->assign(padded, 0.0f);
+  }
+
+  // the threshold's own index, which has to be an exact cut
+  auto threshold = [&](uint32_t f_id_, float v_) {
+    if(f_id_ >= bins_.num_preds()) {
+      throw std::invalid_argument("split on predictor " + std::to_string(f_id_) + " of " + std::to_string(bins_.num_preds()));
+    }
+    uint32_t k = bins_.bin(f_id_, v_);
+    if(k == bins_.cuts[f_id_].size() || bins_.cuts[f_id_][k] != v_) {
+      throw std::invalid_argument("split value is not one of the cuts of predictor " + std::to_string(f_id_));
+    }
+    return (int16_t)k;
+  };
+
+  for(size_t i = 0 ; i < size ; ++i) {
+    a_splitVarID[i] = f_.a_splitVarID[i];
+    c_splitVarID[i] = f_.c_splitVarID[i];
+    e_splitVarID[i] = f_.e_splitVarID[i];
+    b_splitBin[i] = threshold(f_.a_splitVarID[i], f_.b_splitValue[i]);
+    d_splitBin[i] = threshold(f_.c_splitVarID[i], f_.d_splitValue[i]);
+    f_splitBin[i] = threshold(f_.e_splitVarID[i], f_.f_splitValue[i]);
+    one[i] = f_.one[i];
+    two[i] = f_.two[i];
+    three[i] = f_.three[i];
+    four[i] = f_.four[i];
+  }
+}
+
+// scalar versions of the kernels for the tails and for non-x86 builds
+template<typename T>
+static float selectq_slow(const T *a, const T *b, const float *x, const float *y, size_t count)
+{
+  float total = 0.0f;
+  for(size_t i = 0 ; i < count ; ++i) {
+    total += a[i] <= b[i] ? x[i] : y[i];
+  }
+  return total;
+}
+
+#if defined(__x86_64__)
+
+// widen the low 8 compare results in m_ (bytes or words) to a float blend mask
+static inline __m256 mask8_epi8(__m128i m_)
+{
+  return _mm256_castsi256_ps(_mm256_cvtepi8_epi32(m_));
+}
+
+static inline __m256 mask8_epi16(__m128i m_)
+{
+  return _mm256_castsi256_ps(_mm256_cvtepi16_epi32(m_));
+}
+
+float selectq(const int8_t *a, const int8_t *b, const float *x, const float *y, size_t count)
+{
+  __m256 tot = _mm256_setzero_ps();
+  size_t n = (count >> 5) << 5;
+  for(size_t i = 0 ; i < n ; i += 32) {
+    __m256i m = _mm256_cmpgt_epi8(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+    __m128i lo = _mm256_castsi256_si128(m), hi = _mm256_extracti128_si256(m, 1);
+    tot = _mm256_add_ps(tot, _mm256_blendv_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), mask8_epi8(lo)));
+    tot = _mm256_add_ps(tot, _mm256_blendv_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8),
+					      mask8_epi8(_mm_srli_si128(lo, 8))));
+    tot = _mm256_add_ps(tot, _mm256_blendv_ps(_mm256_loadu_ps(x + i + 16), _mm256_loadu_ps(y + i + 16), mask8_epi8(hi)));
+    tot = _mm256_add_ps(tot, _mm256_blendv_ps(_mm256_loadu_ps(x + i + 24), _mm256_loadu_ps(y + i + 24),
+					      mask8_epi8(_mm_srli_si128(hi, 8))));
+  }
+  return (horizontal_add(tot) + selectq_slow(a + n, b + n, x + n, y + n, count - n)) / count;
+}
+
+float selectq(const int16_t *a, const int16_t *b, const float *x, const float *y, size_t count)
+{
+  __m256 tot = _mm256_setzero_ps();
+  size_t n = (count >> 4) << 4;
+  for(size_t i = 0 ; i < n ; i += 16) {
+    __m256i m = _mm256_cmpgt_epi16(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+    tot = _mm256_add_ps(tot, _mm256_blendv_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i),
+					      mask8_epi16(_mm256_castsi256_si128(m))));
+    tot = _mm256_add_ps(tot, _mm256_blendv_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8),
+					      mask8_epi16(_mm256_extracti128_si256(m, 1))));
+  }
+  return (horizontal_add(tot) + selectq_slow(a + n, b + n, x + n, y + n, count - n)) / count;
+}
+
+// the bins of 16 trees' features: two 8 lane gathers of the 32 bits at each 16-bit slot, sign extended
+// from the low half and packed back to 16 lanes in tree order
+static inline __m256i gather_bins16(const int16_t *qx_, const uint16_t *id_)
+{
+  __m256i g0 = _mm256_i32gather_epi32((const int *)qx_, _mm256_cvtepu16_epi32(_mm_load_si128((const __m128i *)id_)), 2);
+  __m256i g1 = _mm256_i32gather_epi32((const int *)qx_, _mm256_cvtepu16_epi32(_mm_load_si128((const __m128i *)(id_ + 8))), 2);
+  g0 = _mm256_srai_epi32(_mm256_slli_epi32(g0, 16), 16);
+  g1 = _mm256_srai_epi32(_mm256_slli_epi32(g1, 16), 16);
+  return _mm256_permute4x64_epi64(_mm256_packs_epi32(g0, g1), 0xd8); // packs works per 128-bit lane
+}
+
+double rf_sum_quantized(const quantized_soa &f_, const int16_t *qx_)
+{
+  __m256d tot = _mm256_setzero_pd();
+  for(size_t i = 0 ; i < f_.one.size() ; i += 16) {
+    // bin > threshold bin, ie !(x <= split), for 16 trees at a time
+    __m256i m1 = _mm256_cmpgt_epi16(gather_bins16(qx_, &f_.a_splitVarID[i]), _mm256_load_si256((const __m256i *)&f_.b_splitBin[i]));
+    __m256i m2 = _mm256_cmpgt_epi16(gather_bins16(qx_, &f_.c_splitVarID[i]), _mm256_load_si256((const __m256i *)&f_.d_splitBin[i]));
+    __m256i m3 = _mm256_cmpgt_epi16(gather_bins16(qx_, &f_.e_splitVarID[i]), _mm256_load_si256((const __m256i *)&f_.f_splitBin[i]));
+
+    for(size_t h = 0 ; h < 2 ; ++h) {
+      size_t j = i + h * 8;
+      __m256 k1 = mask8_epi16(h ? _mm256_extracti128_si256(m1, 1) : _mm256_castsi256_si128(m1));
+      __m256 k2 = mask8_epi16(h ? _mm256_extracti128_si256(m2, 1) : _mm256_castsi256_si128(m2));
+      __m256 k3 = mask8_epi16(h ? _mm256_extracti128_si256(m3, 1) : _mm256_castsi256_si128(m3));
+
+      __m256 left = _mm256_blendv_ps(_mm256_load_ps(&f_.one[j]), _mm256_load_ps(&f_.two[j]), k2);
+      __m256 right = _mm256_blendv_ps(_mm256_load_ps(&f_.three[j]), _mm256_load_ps(&f_.four[j]), k3);
+      __m256 res = _mm256_blendv_ps(left, right, k1);
+      tot = _mm256_add_pd(tot, _mm256_cvtps_pd(_mm256_castps256_ps128(res)));
+      tot = _mm256_add_pd(tot, _mm256_cvtps_pd(_mm256_extractf128_ps(res, 1)));
+    }
+  }
+  return horizontal_add(tot);
+}
+
+#else
+
+float selectq(const int8_t *a, const int8_t *b, const float *x, const float *y, size_t count)
+{
+  return selectq_slow(a, b, x, y, count) / count;
+}
+
+float selectq(const int16_t *a, const int16_t *b, const float *x, const float *y, size_t count)
+{
+  return selectq_slow(a, b, x, y, count) / count;
+}
+
+double rf_sum_quantized(const quantized_soa &f_, const int16_t *qx_)
+{
+  double tot = 0.0;
+  for(size_t i = 0 ; i < f_.size ; ++i) {
+    if(qx_[f_.a_splitVarID[i]] <= f_.b_splitBin[i]) {
+      tot += qx_[f_.c_splitVarID[i]] <= f_.d_splitBin[i] ? f_.one[i] : f_.two[i];
+    } else {
+      tot += qx_[f_.e_splitVarID[i]] <= f_.f_splitBin[i] ? f_.three[i] : f_.four[i];
+    }
+  }
+  return tot;
+}
+
+#endif
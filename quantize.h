@@ -0,0 +1,72 @@
+//
+// quantized (histogram style) split comparisons
+//
+// a split only ever asks x[splitVarID] <= splitValue, so all that matters about a feature value is where it
+// falls among that feature's split values.  if cuts[f] holds the sorted distinct split values on feature f
+// and bin(f, v) is the number of cuts below v, then
+//
+// v <= cuts[f][k]  <=>  bin(f, v) <= k
+//
+// exactly, so a forest can store each threshold as its index k and each row is binned once up front
+// (a NaN feature gets the largest bin so it still goes right).  the compares are then on small integers,
+// 16 or 32 per _mm256_cmpgt_epi16/epi8 instead of 8 per float compare, and the model streams less memory
+//
+// int8 bins need at most 127 distinct splits per feature and int16 at most 32767, building a quantized
+// forest with more throws std::invalid_argument
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "aligned.h"
+#include "forest_soa.h"
+
+// the distinct split values of every feature of a forest
+struct feature_bins {
+  std::vector<std::vector<float>> cuts;
+
+  feature_bins() = default;
+  explicit feature_bins(size_t num_preds_) : cuts(num_preds_) {}
+  feature_bins(const forest2_soa &f_, size_t num_preds_);
+
+  void add(uint32_t splitVarID_, float splitValue_);
+  void finish();       // sort and dedup, call once after the last add
+
+  size_t num_preds() const { return cuts.size(); }
+  size_t max_cuts() const;
+
+  // number of cuts on feature f_ below v_ (the index of v_ itself if it is a cut)
+  uint32_t bin(uint32_t f_, float v_) const;
+
+  // bins for a whole row x_ of num_preds() features, out_ needs num_preds() + 1 entries
+  // (the kernels gather 32 bits at each 16-bit slot, so one slot of padding)
+  void quantize(const float *x_, int16_t *out_) const;
+};
+
+// selectf on pre-binned a and b (ie a[i] <= b[i] ? x[i] : y[i]), 32 or 16 compares per instruction
+// any count and alignment, like selectf
+float selectq(const int8_t *a, const int8_t *b, const float *x, const float *y, size_t count);
+float selectq(const int16_t *a, const int16_t *b, const float *x, const float *y, size_t count);
+
+// forest2_soa with 16-bit feature ids and int16 bin thresholds (the leaves stay float), padded to a
+// multiple of 16 trees: 28 bytes per tree instead of 40
+struct quantized_soa {
+  aligned_vector<uint16_t> a_splitVarID, c_splitVarID, e_splitVarID;
+  aligned_vector<int16_t> b_splitBin, d_splitBin, f_splitBin;
+  aligned_vector<float> one, two, three, four;
+  size_t size = 0;
+
+  // every split value of f_ must be one of bins_'s cuts (true when bins_ was built from f_)
+  quantized_soa(const forest2_soa &f_, const feature_bins &bins_);
+};
+
+// sum of the tree predictions for a row binned with feature_bins::quantize
+double rf_sum_quantized(const quantized_soa &f_, const int16_t *qx_);
+
+inline double rf_eval_quantized(const quantized_soa &f_, const int16_t *qx_)
+{
+  return rf_sum_quantized(f_, qx_) / f_.size;
+}
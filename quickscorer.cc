@@ -0,0 +1,124 @@
+//
+// quickscorer style evaluation (see quickscorer.h)
+//
+
+#include "quickscorer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+#include "compile.h"
+
+// one split node while building
+struct qs_split {
+  uint32_t splitVarID;
+  float splitValue;
+  uint32_t tree_id;
+  uint32_t first, last;   // leaves [first, last) of the node's left subtree
+};
+
+// numbers the leaves under nodeID_ from next_ on, collecting a condition for every split
+static void collect(const tree &t_, size_t nodeID_, uint32_t tree_id_, uint32_t &next_,
+		    std::vector<float> &leaves_, std::vector<qs_split> &out_)
+{
+  const node &n = t_[nodeID_];
+  if(n.leftChildNodeID == 0 && n.rightChildNodeID == 0) {
+    leaves_.push_back(n.splitValue);
+    ++next_;
+    return;
+  }
+  // the conditions are sorted by threshold, which needs thresholds that compare
+  if(std::isnan(n.splitValue)) {
+    throw std::invalid_argument("NaN split value on predictor " + std::to_string(n.splitVarID));
+  }
+  uint32_t first = next_;
+  collect(t_, n.leftChildNodeID, tree_id_, next_, leaves_, out_);
+  out_.push_back({(uint32_t)n.splitVarID, n.splitValue, tree_id_, first, next_});
+  collect(t_, n.rightChildNodeID, tree_id_, next_, leaves_, out_);
+}
+
+quickscorer_forest::quickscorer_forest(const std::vector<tree> &f_, size_t num_preds_)
+  : offset(num_preds_ + 1, 0), size(f_.size())
+{
+  size_t depth = forest_depth(f_, num_preds_);
+  if(depth > QUICKSCORER_MAX_DEPTH) {
+    throw std::invalid_argument("tree is deeper than " + std::to_string(QUICKSCORER_MAX_DEPTH));
+  }
+  words = depth <= 6 ? 1 : depth == 7 ? 2 : 4;
+
+  std::vector<qs_split> splits;
+  for(size_t t = 0 ; t < f_.size() ; ++t) {
+    uint32_t next = 0;
+    leaf_offset.push_back(leaves.size());
+    collect(f_[t], 0, t, next, leaves, splits);
+  }
+
+  // group by feature, ascending thresholds
+  std::stable_sort(splits.begin(), splits.end(), [](const qs_split &l_, const qs_split &r_) {
+    return l_.splitVarID != r_.splitVarID ? l_.splitVarID < r_.splitVarID : l_.splitValue < r_.splitValue;
+  });
+
+  for(const auto &s : splits) {
+    ++offset[s.splitVarID + 1];
+    threshold.push_back(s.splitValue);
+    tree_id.push_back(s.tree_id);
+    for(uint32_t w = 0 ; w < words ; ++w) {
+      // clear bits [first, last) of word w
+      uint64_t m = ~0ull;
+      for(uint32_t l = std::max(s.first, w * 64) ; l < std::min(s.last, (w + 1) * 64) ; ++l) {
+	m &= ~(1ull << (l - w * 64));
+      }
+      mask.push_back(m);
+    }
+  }
+  std::partial_sum(offset.begin(), offset.end(), offset.begin());
+}
+
+template<size_t W>
+static double rf_sum_quickscorer_words(const quickscorer_forest &f_, const float *x_)
+{
+  // per thread leaf bitvectors, reused between calls
+  static thread_local std::vector<uint64_t> v;
+  v.assign(f_.size * W, ~0ull);
+
+  const size_t num_preds = f_.offset.size() - 1;
+  for(size_t f = 0 ; f < num_preds ; ++f) {
+    // !(<=) so a NaN fails every test, even against a +inf threshold
+    const float xf = x_[f];
+    for(size_t c = f_.offset[f] ; c < f_.offset[f + 1] && !(xf <= f_.threshold[c]) ; ++c) {
+      uint64_t *tv = &v[f_.tree_id[c] * W];
+      const uint64_t *m = &f_.mask[c * W];
+      for(size_t w = 0 ; w < W ; ++w) {
+	tv[w] &= m[w];
+      }
+    }
+  }
+
+  // the exit leaf is the lowest set bit (there is always one, the rightmost leaf is never cleared)
+  double total = 0.0;
+  for(size_t t = 0 ; t < f_.size ; ++t) {
+    const uint64_t *tv = &v[t * W];
+    size_t w = 0;
+    while(tv[w] == 0) {
+      ++w;
+    }
+    total += f_.leaves[f_.leaf_offset[t] + w * 64 + __builtin_ctzll(tv[w])];
+  }
+  return total;
+}
+
+double rf_sum_quickscorer(const quickscorer_forest &f_, const float *x_)
+{
+  switch(f_.words) {
+  case 1:
+    return rf_sum_quickscorer_words<1>(f_, x_);
+  case 2:
+    return rf_sum_quickscorer_words<2>(f_, x_);
+  default:
+    return rf_sum_quickscorer_words<4>(f_, x_);
+  }
+}
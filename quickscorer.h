@@ -0,0 +1,54 @@
+//
+// quickscorer style evaluation for deeper trees
+//
+// simd_forest walks every tree level by level, which is fine up to depth 6 or so but costs a gather per
+// level per 8 trees, and padding to complete trees doubles the storage with every level.  quickscorer turns
+// the forest inside out instead:
+//
+// - the leaves of each tree are numbered left to right, and every split node gets a mask with the bits of
+//   the leaves in its left subtree cleared
+// - if a node's test fails (x > threshold, ie the walk would go right) none of those leaves can be reached,
+//   so and-ing the masks of all the failing nodes into a per-tree bitvector (all ones to start) leaves the
+//   exit leaf as the lowest set bit
+// - the conditions of the whole forest are grouped by feature and sorted by threshold, so for each feature
+//   we and masks in until the first threshold >= x (from there on every test passes) and stop: no per-tree
+//   traversal, and only the failing nodes are ever touched
+//
+// leaf bitvectors are 1, 2 or 4 64-bit words (up to 64, 128 or 256 leaves) depending on the largest tree, so
+// this covers trees up to depth 8.  a NaN feature fails every test, like in tree_eval, and a NaN threshold
+// (which wouldn't sort) is refused
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "forest.h"
+
+// deepest trees quickscorer_forest takes
+const size_t QUICKSCORER_MAX_DEPTH = 8;
+
+struct quickscorer_forest {
+  size_t words = 1;                    // 64-bit words per leaf bitvector
+  std::vector<uint32_t> offset;        // conditions on feature f are [offset[f], offset[f + 1])
+  std::vector<float> threshold;        // ascending within each feature
+  std::vector<uint32_t> tree_id;
+  std::vector<uint64_t> mask;          // words per condition
+  std::vector<uint32_t> leaf_offset;   // first leaf of each tree in leaves
+  std::vector<float> leaves;
+  size_t size = 0;
+
+  // validates every tree (see compile.h), throwing std::invalid_argument for trees deeper than QUICKSCORER_MAX_DEPTH
+  // or with a NaN split value
+  quickscorer_forest(const std::vector<tree> &f_, size_t num_preds_);
+};
+
+// sum of the tree predictions for sample x_
+double rf_sum_quickscorer(const quickscorer_forest &f_, const float *x_);
+
+inline double rf_eval_quickscorer(const quickscorer_forest &f_, const std::vector<float> &x_)
+{
+  return rf_sum_quickscorer(f_, &x_[0]) / f_.size;
+}
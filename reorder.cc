@@ -0,0 +1,37 @@
+//
+// depth-2 forest reordering (see reorder.h)
+//
+
+#include "reorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <tuple>
+#include <utility>
+
+std::vector<size_t> feature_order(const forest2 &f_)
+{
+  std::vector<size_t> order(f_.size());
+  std::iota(order.begin(), order.end(), 0);
+
+  // < on floats isn't a strict weak order once there are NaNs, so they get a key of their own past every number
+  auto threshold = [](float v_) { return std::make_pair(std::isnan(v_), std::isnan(v_) ? 0.0f : v_); };
+  auto key = [&](size_t i_) {
+    const tree2 &t = f_[i_];
+    return std::make_tuple(t.a_splitVarID, t.c_splitVarID, t.e_splitVarID, threshold(t.b_splitValue),
+			   threshold(t.d_splitValue), threshold(t.f_splitValue));
+  };
+  std::stable_sort(order.begin(), order.end(), [&](size_t l_, size_t r_) { return key(l_) < key(r_); });
+  return order;
+}
+
+forest2 reorder_forest2(const forest2 &f_)
+{
+  forest2 out;
+  out.reserve(f_.size());
+  for(size_t i : feature_order(f_)) {
+    out.push_back(f_[i]);
+  }
+  return out;
+}
@@ -0,0 +1,25 @@
+//
+// offline reordering of depth-2 forests by split feature
+//
+// a forest comes out of training in no particular order, so consecutive trees split on unrelated features
+// and every gather (or tree_eval_simd's pair of loads) hits a random x_[splitVarID].  a sum doesn't care
+// about order, so we can sort the trees by (root feature, left child feature, right child feature): runs of
+// trees then read the same features, adjacent lanes of a gather hit the same cache line, and thresholds on
+// the same feature sit next to each other.  within a feature the trees are also sorted by threshold, NaN
+// thresholds (which send every sample right) after all the others
+//
+// the result is the same forest, only the fp rounding of the sum changes (vectest2 reports by how much)
+//
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "forest.h"
+
+// the permutation that sorts f_ by split features, ie the reordered forest is f_[order[0]], f_[order[1]], ...
+std::vector<size_t> feature_order(const forest2 &f_);
+
+// f_ in feature_order
+forest2 reorder_forest2(const forest2 &f_);
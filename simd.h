@@ -0,0 +1,80 @@
+//
+// small simd helpers shared by the kernels
+//
+
+#pragma once
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// sliding window for the tail masks below: 8 set lanes followed by 8 clear ones
+alignas(64) inline const int32_t tail_mask_table[16] = {-1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0};
+
+// mask with the first n_ (0..8) lanes set, for _mm256_maskload_ps on the last partial register
+inline __m256i tail_mask8(size_t n_) {
+  return _mm256_loadu_si256((const __m256i *)(tail_mask_table + 8 - n_));
+}
+
+// the same for 4 lanes (n_ is 0..4), for _mm_maskload_ps
+inline __m128i tail_mask4(size_t n_) {
+  return _mm_loadu_si128((const __m128i *)(tail_mask_table + 8 - n_));
+}
+
+// sum the 8 lanes of a 256-bit register (note: clobbers a)
+inline float horizontal_add(__m256 &a) {
+  a = _mm256_hadd_ps(a,a);
+  a = _mm256_hadd_ps(a,a);
+  __m128 t1 = _mm256_extractf128_ps(a,1);
+  t1 = _mm_add_ss(_mm256_castps256_ps128(a),t1);
+  return _mm_cvtss_f32(t1);
+}
+
+// sum the 4 lanes of a 128-bit register (note: clobbers a)
+inline float horizontal_add(__m128 &a) {
+  a = _mm_hadd_ps(a,a);
+  a = _mm_hadd_ps(a,a);
+  return _mm_cvtss_f32(a);
+}
+
+// one step of compensated (kahan) summation in every lane: sum_ += v_, with the bits that didn't fit kept in c_
+inline void kahan_add(__m256 &sum_, __m256 &c_, __m256 v_) {
+  __m256 y = _mm256_sub_ps(v_, c_);
+  __m256 t = _mm256_add_ps(sum_, y);
+  c_ = _mm256_sub_ps(_mm256_sub_ps(t, sum_), y);
+  sum_ = t;
+}
+
+inline void kahan_add(__m128 &sum_, __m128 &c_, __m128 v_) {
+  __m128 y = _mm_sub_ps(v_, c_);
+  __m128 t = _mm_add_ps(sum_, y);
+  c_ = _mm_sub_ps(_mm_sub_ps(t, sum_), y);
+  sum_ = t;
+}
+
+// the lanes of a kahan sum and their corrections added up in double
+inline double kahan_total(__m256 sum_, __m256 c_) {
+  __m256d lo = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(sum_)), _mm256_cvtps_pd(_mm256_castps256_ps128(c_)));
+  __m256d hi = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(sum_, 1)), _mm256_cvtps_pd(_mm256_extractf128_ps(c_, 1)));
+  __m256d t = _mm256_add_pd(lo, hi);
+  __m128d h = _mm_add_pd(_mm256_castpd256_pd128(t), _mm256_extractf128_pd(t, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+}
+
+inline double kahan_total(__m128 sum_, __m128 c_) {
+  __m256d t = _mm256_sub_pd(_mm256_cvtps_pd(sum_), _mm256_cvtps_pd(c_));
+  __m128d h = _mm_add_pd(_mm256_castpd256_pd128(t), _mm256_extractf128_pd(t, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+}
+
+// sum the 4 lanes of a 256-bit double register
+inline double horizontal_add(__m256d &a) {
+  __m128d t = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+  t = _mm_add_sd(t, _mm_unpackhi_pd(t, t));
+  return _mm_cvtsd_f64(t);
+}
+
+#endif
@@ -0,0 +1,162 @@
+//
+// simd evaluation of complete trees of any (compile time) depth
+//
+// forest_soa.h does depth 2 by giving every lane its own tree and having each lane pick its leaf with
+// blends.  blends stop scaling past depth 2 (2^depth leaves to choose from), so here each lane instead
+// walks its own tree a level at a time, keeping its position within the current level as an integer:
+//
+// idx = 0
+// for each level l:
+//   node = (2^l - 1) + idx                       // heap order, children of n are 2n+1 and 2n+2
+//   bit = !(x[splitVarID[node]] <= splitValue[node])  // 1 = go right
+//   idx = (idx << 1) | bit
+// result = leaf[idx]
+//
+// ie the leaf index is built up from one compare mask bit per level.  each level is a gather of the split
+// ids, a gather of the features, a gather of the thresholds and a compare, and the levels are expanded at
+// compile time so every depth gets its own fully unrolled kernel
+//
+// trees are stored in groups of 8 (one per lane), node n of lane i of group g being at (g * NODES + n) * 8 + i
+// so level 0 needs plain loads rather than gathers
+//
+
+#pragma once
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "aligned.h"
+#include "simd.h"
+
+// a complete tree of depth Depth, internal nodes in heap order and leaves left to right
+template<size_t Depth>
+struct packed_tree {
+  static constexpr size_t NODES = (size_t(1) << Depth) - 1;
+  static constexpr size_t LEAVES = size_t(1) << Depth;
+
+  std::array<uint32_t, NODES> splitVarID;
+  std::array<float, NODES> splitValue;
+  std::array<float, LEAVES> leaf;
+};
+
+template<size_t Depth>
+struct simd_forest {
+  static_assert(Depth >= 1 && Depth <= 16, "unsupported tree depth");
+
+  static constexpr size_t NODES = packed_tree<Depth>::NODES;
+  static constexpr size_t LEAVES = packed_tree<Depth>::LEAVES;
+
+  aligned_vector<uint32_t> splitVarID;
+  aligned_vector<float> splitValue;
+  aligned_vector<float> leaf;
+  size_t size = 0;     // number of real trees, the last group is padded out with all-zero trees
+
+  size_t groups() const { return leaf.size() / (LEAVES * 8); }
+
+  void push_back(const packed_tree<Depth> &t_) {
+    if(size == groups() * 8) {
+      splitVarID.resize(splitVarID.size() + NODES * 8, 0);
+      splitValue.resize(splitValue.size() + NODES * 8, 0.0f);
+      leaf.resize(leaf.size() + LEAVES * 8, 0.0f);
+    }
+    size_t g = size / 8, lane = size % 8;
+    for(size_t n = 0 ; n < NODES ; ++n) {
+      splitVarID[(g * NODES + n) * 8 + lane] = t_.splitVarID[n];
+      splitValue[(g * NODES + n) * 8 + lane] = t_.splitValue[n];
+    }
+    for(size_t n = 0 ; n < LEAVES ; ++n) {
+      leaf[(g * LEAVES + n) * 8 + lane] = t_.leaf[n];
+    }
+    ++size;
+  }
+};
+
+#if defined(__x86_64__)
+
+// one level of the walk for 8 trees, L is known at compile time
+template<size_t L>
+inline __m256i simd_forest_level(const uint32_t *ids_, const float *vals_, const float *x_, __m256i idx_)
+{
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i id;
+  __m256 val;
+  if constexpr (L == 0) {
+    id = _mm256_load_si256((const __m256i *)ids_);
+    val = _mm256_load_ps(vals_);
+  } else {
+    __m256i off = _mm256_add_epi32(_mm256_slli_epi32(_mm256_add_epi32(idx_, _mm256_set1_epi32((1 << L) - 1)), 3), lanes);
+    id = _mm256_i32gather_epi32((const int *)ids_, off, 4);
+    val = _mm256_i32gather_ps(vals_, off, 4);
+  }
+  __m256 feat = _mm256_i32gather_ps(x_, id, 4);
+  __m256i bit = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cmp_ps(feat, val, _CMP_NLE_UQ)), 31); // 1 = right
+  return _mm256_or_si256(_mm256_slli_epi32(idx_, 1), bit);
+}
+
+// leaf values of trees [g * 8, g * 8 + 8) for sample x_
+template<size_t Depth, size_t... L>
+inline __m256 simd_forest_group(const simd_forest<Depth> &f_, size_t g_, const float *x_, std::index_sequence<L...>)
+{
+  const uint32_t *ids = &f_.splitVarID[g_ * simd_forest<Depth>::NODES * 8];
+  const float *vals = &f_.splitValue[g_ * simd_forest<Depth>::NODES * 8];
+  __m256i idx = _mm256_setzero_si256();
+  ((idx = simd_forest_level<L>(ids, vals, x_, idx)), ...);
+
+  __m256i off = _mm256_add_epi32(_mm256_slli_epi32(idx, 3), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  return _mm256_i32gather_ps(&f_.leaf[g_ * simd_forest<Depth>::LEAVES * 8], off, 4);
+}
+
+// sum of the tree predictions for sample x_
+template<size_t Depth>
+double rf_sum_simd(const simd_forest<Depth> &f_, const float *x_)
+{
+  __m256d total = _mm256_setzero_pd();
+  for(size_t g = 0 ; g < f_.groups() ; ++g) {
+    __m256 res = simd_forest_group(f_, g, x_, std::make_index_sequence<Depth>());
+    total = _mm256_add_pd(total, _mm256_cvtps_pd(_mm256_castps256_ps128(res)));
+    total = _mm256_add_pd(total, _mm256_cvtps_pd(_mm256_extractf128_ps(res, 1)));
+  }
+  return horizontal_add(total);
+}
+
+#else
+
+// no gathers to lean on (neon), so each lane's tree is walked with scalar code over the same layout
+template<size_t Depth>
+double rf_sum_simd(const simd_forest<Depth> &f_, const float *x_)
+{
+  const size_t NODES = simd_forest<Depth>::NODES, LEAVES = simd_forest<Depth>::LEAVES;
+  double total = 0.0;
+  for(size_t g = 0 ; g < f_.groups() ; ++g) {
+    for(size_t lane = 0 ; lane < 8 ; ++lane) {
+      size_t idx = 0;
+      for(size_t l = 0 ; l < Depth ; ++l) {
+	size_t off = (g * NODES + (size_t(1) << l) - 1 + idx) * 8 + lane;
+	idx = (idx << 1) | !(x_[f_.splitVarID[off]] <= f_.splitValue[off]);
+      }
+      total += f_.leaf[(g * LEAVES + idx) * 8 + lane];
+    }
+  }
+  return total;
+}
+
+#endif
+
+// average prediction of the forest for sample x_ (same result as rf_eval on the original forest)
+template<size_t Depth>
+double rf_eval_simd(const simd_forest<Depth> &f_, const float *x_)
+{
+  return rf_sum_simd(f_, x_) / f_.size;
+}
+
+template<size_t Depth>
+double rf_eval_simd(const simd_forest<Depth> &f_, const std::vector<float> &x_)
+{
+  return rf_eval_simd(f_, &x_[0]);
+}
@@ -0,0 +1,193 @@
+//
+// double buffered scoring of columnar data (see stream.h)
+//
+
+#include "stream.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "aligned.h"
+#include "parallel.h"
+
+mapped_feature_matrix::mapped_feature_matrix(const std::string &path_, size_t num_preds_)
+  : data(nullptr), length(0)
+{
+  if(num_preds_ == 0) {
+    throw std::runtime_error(path_ + ": a feature matrix needs at least one predictor");
+  }
+  int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd < 0) {
+    throw std::runtime_error("can't open " + path_ + ": " + strerror(errno));
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (size_t)st.st_size % (num_preds_ * sizeof(float)) != 0) {
+    close(fd);
+    throw std::runtime_error(path_ + ": not a matrix of " + std::to_string(num_preds_) + " float columns");
+  }
+  length = st.st_size;
+  if(length > 0) {
+    data = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd); // the mapping keeps the file alive
+  if(data == MAP_FAILED) {
+    throw std::runtime_error("can't map " + path_ + ": " + strerror(errno));
+  }
+  if(data) {
+    // every column is read front to back, so let the kernel read ahead
+    madvise(data, length, MADV_SEQUENTIAL);
+  }
+
+  src.rows = length / (num_preds_ * sizeof(float));
+  for(size_t j = 0 ; j < num_preds_ ; ++j) {
+    src.columns.push_back({ (const float *)data + j * src.rows });
+  }
+}
+
+mapped_feature_matrix::~mapped_feature_matrix()
+{
+  if(data) {
+    munmap(data, length);
+  }
+}
+
+void save_feature_matrix(const float *x_, size_t rows_, size_t num_preds_, const std::string &path_)
+{
+  std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+  if(!out) {
+    throw std::runtime_error("can't write " + path_);
+  }
+  out.write((const char *)x_, rows_ * num_preds_ * sizeof(float));
+  if(!out.flush()) {
+    throw std::runtime_error("error writing " + path_);
+  }
+}
+
+// copy rows [first_, first_ + n_) of src_ into stage_, row-major, nulls as NaN
+static void stage_rows(const column_source &src_, size_t first_, size_t n_, float *stage_)
+{
+  const size_t np = src_.num_preds();
+  for(size_t j = 0 ; j < np ; ++j) {
+    const feature_column &c = src_.columns[j];
+    const float *v = c.values + first_;
+    if(!c.validity) {
+      for(size_t r = 0 ; r < n_ ; ++r) {
+	stage_[r * np + j] = v[r];
+      }
+    } else {
+      for(size_t r = 0 ; r < n_ ; ++r) {
+	size_t bit = c.validity_offset + first_ + r;
+	stage_[r * np + j] = (c.validity[bit >> 3] >> (bit & 7)) & 1 ? v[r] : NAN;
+      }
+    }
+  }
+}
+
+// the pipeline: score_(rows, n, out) scores n row-major rows of staging while the next block is staged
+template<typename SCORE>
+static void stream_blocks(const column_source &src_, size_t block_, double *out, SCORE score_)
+{
+  if(block_ == 0) {
+    throw std::invalid_argument("rf_eval_stream needs a block of at least one row");
+  }
+  const size_t rows = src_.rows;
+  const size_t blocks = (rows + block_ - 1) / block_;
+  aligned_vector<float> stage[2];
+  stage[0].resize(block_ * src_.num_preds());
+  stage[1].resize(block_ * src_.num_preds());
+
+  auto fill = [&](size_t b_) {
+    size_t first = b_ * block_;
+    stage_rows(src_, first, std::min(block_, rows - first), stage[b_ & 1].data());
+  };
+
+  if(blocks == 0) {
+    return;
+  }
+
+  // one staging thread for the whole stream, kept at most one block ahead: block b goes into stage[b & 1]
+  // once block b - 2 has been scored.  a lock per block is nothing next to staging and scoring it
+  std::mutex lock;
+  std::condition_variable moved;
+  size_t staged = 0, scored = 0;
+  bool quit = false;
+  std::thread stager([&]() {
+    for(size_t b = 0 ; b < blocks ; ++b) {
+      {
+	std::unique_lock<std::mutex> l(lock);
+	moved.wait(l, [&]() { return quit || b < scored + 2; });
+	if(quit) {
+	  return;
+	}
+      }
+      fill(b);
+      {
+	std::lock_guard<std::mutex> l(lock);
+	staged = b + 1;
+      }
+      moved.notify_one();
+    }
+  });
+
+  try {
+    for(size_t b = 0 ; b < blocks ; ++b) {
+      {
+	std::unique_lock<std::mutex> l(lock);
+	moved.wait(l, [&]() { return staged > b; });
+      }
+      size_t first = b * block_;
+      score_(stage[b & 1].data(), std::min(block_, rows - first), out + first);
+      {
+	std::lock_guard<std::mutex> l(lock);
+	scored = b + 1;
+      }
+      moved.notify_one();
+    }
+  } catch(...) {
+    // the buffers go away with us, so the stager has to be stopped first
+    {
+      std::lock_guard<std::mutex> l(lock);
+      quit = true;
+    }
+    moved.notify_one();
+    stager.join();
+    throw;
+  }
+  stager.join();
+}
+
+void rf_eval_stream(const forest2 &f_, const column_source &src_, double *out, size_t block_)
+{
+  const size_t np = src_.num_preds();
+  stream_blocks(src_, block_, out, [&](const float *x_, size_t n_, double *out_) {
+    rf_eval_simd_batch(f_, x_, n_, np, sample_layout::row_major, out_);
+  });
+}
+
+void rf_eval_stream(const forest2_soa &f_, const column_source &src_, double *out, size_t block_)
+{
+  const size_t np = src_.num_preds();
+  stream_blocks(src_, block_, out, [&](const float *x_, size_t n_, double *out_) {
+    rf_eval_parallel_batch(f_, x_, n_, np, out_);
+  });
+}
+
+void rf_eval_stream(const stump_forest &f_, const column_source &src_, double *out, size_t block_)
+{
+  const size_t np = src_.num_preds();
+  stream_blocks(src_, block_, out, [&](const float *x_, size_t n_, double *out_) {
+    rf_eval_stumps_batch(f_, x_, n_, np, out_);
+  });
+}
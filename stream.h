@@ -0,0 +1,82 @@
+//
+// streaming scorer for columnar feature data
+//
+// offline jobs keep their features by column: an arrow record batch, or one big mmap'd float matrix with
+// each predictor's values for every row stored together.  the kernels want rows, so the stream walks the
+// rows in blocks, transposing each block of columns into a row-major staging buffer and handing it to the
+// batched kernel for the forest.  there are two staging buffers: while one block is being scored, a
+// staging thread (one for the whole stream) copies the next one in, which is also where an mmap'd matrix
+// gets paged in, so the reads overlap the scoring
+//
+// the columns themselves are never copied as a whole, a column_source is just pointers into them
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "forest.h"
+#include "forest_soa.h"
+#include "stumps.h"
+
+// rows per block, 1024 rows of 256 predictors is 1MB of staging per buffer
+const size_t STREAM_BLOCK = 1024;
+
+// one float32 column, values[r] is the predictor's value for row r
+//
+// for an arrow Float32Array (c data interface) values is (const float *)buffers[1] + offset, and validity
+// is buffers[0] (nullptr when there are no nulls) with validity_offset = offset.  a null reads as NaN, which
+// every kernel sends right
+struct feature_column {
+  const float *values;
+  const uint8_t *validity = nullptr;  // arrow style bitmap, bit r (lsb first) set = row r is valid
+  size_t validity_offset = 0;
+};
+
+// the predictors of rows rows: column j is predictor j, so the forest must only split on predictors
+// below columns.size()
+struct column_source {
+  std::vector<feature_column> columns;
+  size_t rows = 0;
+
+  size_t num_preds() const { return columns.size(); }
+};
+
+// a headerless file of num_preds_ float32 columns back to back (predictor j of row r at float j * rows + r,
+// native byte order), mapped read-only.  throws std::runtime_error if it can't be mapped or its size
+// isn't a multiple of a row
+class mapped_feature_matrix {
+public:
+  mapped_feature_matrix(const std::string &path_, size_t num_preds_);
+  ~mapped_feature_matrix();
+
+  mapped_feature_matrix(const mapped_feature_matrix &) = delete;
+  mapped_feature_matrix &operator=(const mapped_feature_matrix &) = delete;
+
+  size_t rows() const { return src.rows; }
+  size_t num_preds() const { return src.num_preds(); }
+
+  // valid until this is destroyed
+  const column_source &columns() const { return src; }
+
+private:
+  void *data;
+  size_t length;
+  column_source src;
+};
+
+// writes a column-major matrix (x_[j * rows_ + r]) in mapped_feature_matrix's format
+void save_feature_matrix(const float *x_, size_t rows_, size_t num_preds_, const std::string &path_);
+
+// score every row of src_, out receives one result per row (what rf_eval_simd, rf_eval_soa or
+// rf_eval_stumps would return for that row).  out can be as big as the source, eg another mapping
+void rf_eval_stream(const forest2 &f_, const column_source &src_, double *out, size_t block_ = STREAM_BLOCK);
+
+// the soa kernel, with the rows of each block spread over the worker pool (see rf_eval_parallel_batch)
+void rf_eval_stream(const forest2_soa &f_, const column_source &src_, double *out, size_t block_ = STREAM_BLOCK);
+
+// the stump kernel, each block scored in tiles of rows (see rf_eval_stumps_batch)
+void rf_eval_stream(const stump_forest &f_, const column_source &src_, double *out, size_t block_ = STREAM_BLOCK);
@@ -0,0 +1,434 @@
+//
+// decision stump kernels
+//
+// basic idea:
+//
+// 1) do a simd comparison of values to generate a mask
+// 2) use the mask to select values
+//
+// i.e. if we had some logic like:
+//
+// if(a[i] <= b[i]) {
+//   tot += x[i];
+// } else {
+//   tot += y[i];
+// }
+//
+// we could do this in parallel with simd instructions, and avoid branching entirely
+//
+// the instrinsics corresponding to the "basic idea" above are:
+// https://software.intel.com/sites/landingpage/IntrinsicsGuide/#techs=AVX&expand=486,518,848,848&text=_mm_cmp_ps
+//
+// and
+//
+// https://software.intel.com/sites/landingpage/IntrinsicsGuide/#techs=SSE4_1&expand=486,518&text=_mm_blendv_ps
+//
+// handy note:
+//
+// we can get an annotated dump like this:
+// objdump -d -M intel -S objs/opt/stumps.o  > stumps.asm
+//
+
+#include "stumps.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include "cpu.h"
+#include "kernels.h"
+#include "simd.h"
+
+static std::atomic<bool> &compensated_flag()
+{
+  static std::atomic<bool> on([]() {
+    const char *p = getenv("SPEEDSTUMPS_COMPENSATED");
+    return p && strcmp(p, "1") == 0;
+  }());
+  return on;
+}
+
+bool compensated_sums()
+{
+  return compensated_flag().load(std::memory_order_relaxed);
+}
+
+void set_compensated_sums(bool on_)
+{
+  compensated_flag().store(on_, std::memory_order_relaxed);
+}
+
+#if defined(__x86_64__)
+template<bool Compensated>
+static float selectf_avx2_impl(const float *a, const float *b, const float *x, const float *y, size_t count);
+#elif defined(__aarch64__)
+static float selectf_compensated(const float *a, const float *b, const float *x, const float *y, size_t count);
+#endif
+
+// dispatch between the kernels in kernels.h, decided on the first call
+float selectf(const float *a, const float *b, const float *x, const float *y, size_t count)
+{
+#if defined(__x86_64__)
+  static const auto impl = selected_isa() == simd_isa::avx512 ? selectf_avx512 : selectf_avx2_impl<false>;
+  if(compensated_sums()) {
+    return selectf_avx2_impl<true>(a, b, x, y, count);
+  }
+#elif defined(__aarch64__)
+  static const auto impl = selected_isa() == simd_isa::sve ? selectf_sve : selectf_neon;
+  if(compensated_sums()) {
+    return selectf_compensated(a, b, x, y, count);
+  }
+#endif
+  return impl(a, b, x, y, count);
+}
+
+#if defined(__x86_64__)
+
+// 256-bit simd implementation
+float selectf_avx2(const float *a, const float *b, const float *x, const float *y, size_t count)
+{
+  return compensated_sums() ? selectf_avx2_impl<true>(a, b, x, y, count) : selectf_avx2_impl<false>(a, b, x, y, count);
+}
+
+// add v_ to a lane sum, with or without a kahan correction
+template<bool Compensated, typename V>
+static inline void accumulate(V &tot_, V &err_, V v_)
+{
+  if constexpr(Compensated) {
+    kahan_add(tot_, err_, v_);
+  } else if constexpr(sizeof(V) == 32) {
+    tot_ = _mm256_add_ps(tot_, v_);
+  } else {
+    tot_ = _mm_add_ps(tot_, v_);
+  }
+}
+
+template<bool Compensated, typename V>
+static inline double lane_total(V &tot_, V err_)
+{
+  if constexpr(Compensated) {
+    return kahan_total(tot_, err_);
+  } else {
+    return horizontal_add(tot_);
+  }
+}
+
+template<bool Compensated>
+static float selectf_avx2_impl(const float *a, const float *b, const float *x, const float *y, size_t count)
+{
+  __m256 tot = _mm256_setzero_ps();
+  __m256 err = _mm256_setzero_ps();
+  size_t n = (count >> 3) << 3;
+  const size_t pf = prefetch_distance() / sizeof(float);
+
+  for(size_t i = 0 ; i < n ; i += 8) {
+    if(pf) {
+      prefetch(a + i + pf);
+      prefetch(b + i + pf);
+      prefetch(x + i + pf);
+      prefetch(y + i + pf);
+    }
+    __m256 mask = _mm256_cmp_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), _CMP_NLE_UQ); // !(<=) (ie the OPPOSITE of <= because we want an inverse result in the mask), so NaNs go right
+    __m256 res = _mm256_blendv_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), mask);
+    accumulate<Compensated>(tot, err, res); // vertically accumulate results
+  }
+
+  // last partial register, the masked off lanes load as 0 so they compare 0 <= 0 and add x = 0
+  if(n < count) {
+    __m256i k = tail_mask8(count - n);
+    __m256 mask = _mm256_cmp_ps(_mm256_maskload_ps(a + n, k), _mm256_maskload_ps(b + n, k), _CMP_NLE_UQ);
+    __m256 res = _mm256_blendv_ps(_mm256_maskload_ps(x + n, k), _mm256_maskload_ps(y + n, k), mask);
+    accumulate<Compensated>(tot, err, res);
+  }
+  
+  return lane_total<Compensated>(tot, err) / count;
+}
+
+template<bool Compensated>
+static float selectf2_impl(const float *a, const float *b, const float *x, const float *y, size_t count)
+{
+  __m128 tot = _mm_setzero_ps();
+  __m128 err = _mm_setzero_ps();
+  size_t n = (count >> 2) << 2;
+
+  for(size_t i = 0 ; i < n ; i += 4) {
+    __m128 mask = _mm_cmp_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i), _CMP_NLE_UQ); // !(<=), see selectf_avx2
+    __m128 res = _mm_blendv_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i), mask);
+    accumulate<Compensated>(tot, err, res); // vertically accumulate results
+  }
+
+  // last partial register, see selectf_avx2
+  if(n < count) {
+    __m128i k = tail_mask4(count - n);
+    __m128 mask = _mm_cmp_ps(_mm_maskload_ps(a + n, k), _mm_maskload_ps(b + n, k), _CMP_NLE_UQ);
+    __m128 res = _mm_blendv_ps(_mm_maskload_ps(x + n, k), _mm_maskload_ps(y + n, k), mask);
+    accumulate<Compensated>(tot, err, res);
+  }
+  
+  return lane_total<Compensated>(tot, err) / count;
+}
+
+// 128-bit simd implementation
+float selectf2(const float *a, const float *b, const float *x, const float *y, size_t count)
+{
+  return compensated_sums() ? selectf2_impl<true>(a, b, x, y, count) : selectf2_impl<false>(a, b, x, y, count);
+}
+
+// evaluate ROWS samples against the same stumps, loading b/x/y once for all of them
+// the per-row accumulators stay in registers (8 rows + b,x,y + temporaries fits in the 16 ymm registers,
+// compensated tiles need two registers a row so they stop at 4 rows)
+template<size_t ROWS, bool Compensated>
+static inline void selectf_tile(const float *a, size_t stride_, const float *b, const float *x, const float *y,
+				size_t count, float *out)
+{
+  __m256 tot[ROWS], err[ROWS];
+  for(size_t r = 0 ; r < ROWS ; ++r) {
+    tot[r] = _mm256_setzero_ps();
+    err[r] = _mm256_setzero_ps();
+  }
+
+  size_t n = (count >> 3) << 3;
+  for(size_t i = 0 ; i < n ; i += 8) {
+    __m256 bv = _mm256_loadu_ps(b + i);
+    __m256 xv = _mm256_loadu_ps(x + i);
+    __m256 yv = _mm256_loadu_ps(y + i);
+    for(size_t r = 0 ; r < ROWS ; ++r) {
+      __m256 mask = _mm256_cmp_ps(_mm256_loadu_ps(a + r * stride_ + i), bv, _CMP_NLE_UQ); // !(<=), see selectf
+      accumulate<Compensated>(tot[r], err[r], _mm256_blendv_ps(xv, yv, mask));
+    }
+  }
+
+  if(n < count) {
+    __m256i k = tail_mask8(count - n);
+    __m256 bv = _mm256_maskload_ps(b + n, k);
+    __m256 xv = _mm256_maskload_ps(x + n, k);
+    __m256 yv = _mm256_maskload_ps(y + n, k);
+    for(size_t r = 0 ; r < ROWS ; ++r) {
+      __m256 mask = _mm256_cmp_ps(_mm256_maskload_ps(a + r * stride_ + n, k), bv, _CMP_NLE_UQ);
+      accumulate<Compensated>(tot[r], err[r], _mm256_blendv_ps(xv, yv, mask));
+    }
+  }
+
+  for(size_t r = 0 ; r < ROWS ; ++r) {
+    out[r] = lane_total<Compensated>(tot[r], err[r]) / count;
+  }
+}
+
+// batched 256-bit simd implementation
+template<bool Compensated>
+static void selectf_batch_impl(const float *a, size_t stride_, const float *b, const float *x, const float *y, size_t count,
+			       size_t rows_, float *out)
+{
+  const size_t TILE = 8;
+  size_t r = 0;
+  if constexpr(!Compensated) {
+    for( ; r + TILE <= rows_ ; r += TILE) {
+      selectf_tile<TILE, false>(a + r * stride_, stride_, b, x, y, count, out + r);
+    }
+  }
+
+  // leftover rows (or all of them, 4 at a time, when compensated), in progressively smaller tiles
+  for( ; r + 4 <= rows_ ; r += 4) {
+    selectf_tile<4, Compensated>(a + r * stride_, stride_, b, x, y, count, out + r);
+  }
+  if(r + 2 <= rows_) {
+    selectf_tile<2, Compensated>(a + r * stride_, stride_, b, x, y, count, out + r);
+    r += 2;
+  }
+  if(r < rows_) {
+    selectf_tile<1, Compensated>(a + r * stride_, stride_, b, x, y, count, out + r);
+  }
+}
+
+void selectf_batch(const float *a, size_t stride_, const float *b, const float *x, const float *y, size_t count,
+		   size_t rows_, float *out)
+{
+  if(compensated_sums()) {
+    selectf_batch_impl<true>(a, stride_, b, x, y, count, rows_, out);
+  } else {
+    selectf_batch_impl<false>(a, stride_, b, x, y, count, rows_, out);
+  }
+}
+
+#elif defined(__aarch64__)
+
+// compensated sums here are a scalar kahan loop for now
+static float selectf_compensated(const float *a, const float *b, const float *x, const float *y, size_t count)
+{
+  float sum = 0.0f, err = 0.0f;
+  for(size_t i = 0 ; i < count ; ++i) {
+    float v = (a[i] <= b[i] ? x[i] : y[i]) - err;
+    float t = sum + v;
+    err = (t - sum) - v;
+    sum = t;
+  }
+  return ((double)sum - err) / count;
+}
+
+// neon registers are 128 bits anyway
+float selectf2(const float *a, const float *b, const float *x, const float *y, size_t count)
+{
+  if(compensated_sums()) {
+    return selectf_compensated(a, b, x, y, count);
+  }
+  return selectf2_neon(a, b, x, y, count);
+}
+
+// no register tiled version here yet, score the rows one at a time
+void selectf_batch(const float *a, size_t stride_, const float *b, const float *x, const float *y, size_t count,
+		   size_t rows_, float *out)
+{
+  for(size_t r = 0 ; r < rows_ ; ++r) {
+    out[r] = selectf(a + r * stride_, b, x, y, count);
+  }
+}
+
+#endif
+
+// this is the traditional (slow) decision stump evaluation function 
+float selectslow(const float *a, const float *b, const float *x, const float *y, size_t count)
+{
+  float total = 0.0;
+  for(size_t i = 0 ; i < count ; ++i) {
+    if(a[i] <= b[i]) {
+      total += x[i];
+    } else {
+      total += y[i];
+    }
+  }
+  return total / count;
+}
+
+void stump_forest::push_back(uint32_t splitVarID_, float splitValue_, float left_, float right_)
+{
+  if(size == left.size()) {
+    splitVarID.resize(size + 8, 0);
+    splitValue.resize(size + 8, 0.0f);
+    left.resize(size + 8, 0.0f);
+    right.resize(size + 8, 0.0f);
+  }
+  splitVarID[size] = splitVarID_;
+  splitValue[size] = splitValue_;
+  left[size] = left_;
+  right[size] = right_;
+  ++size;
+}
+
+#if defined(__x86_64__)
+
+static double rf_sum_stumps_avx2(const stump_forest &f_, const float *x_)
+{
+  __m256d tot = _mm256_setzero_pd();
+  const size_t pf = prefetch_distance() / sizeof(float);
+  for(size_t i = 0 ; i < f_.left.size() ; i += 8) {
+    if(pf) {
+      prefetch(&f_.splitVarID[i] + pf);
+      prefetch(&f_.splitValue[i] + pf);
+      prefetch(&f_.left[i] + pf);
+      prefetch(&f_.right[i] + pf);
+    }
+    __m256 a = _mm256_i32gather_ps(x_, _mm256_load_si256((const __m256i *)&f_.splitVarID[i]), 4);
+    __m256 mask = _mm256_cmp_ps(a, _mm256_load_ps(&f_.splitValue[i]), _CMP_NLE_UQ); // !(<=), so NaNs go right
+    __m256 res = _mm256_blendv_ps(_mm256_load_ps(&f_.left[i]), _mm256_load_ps(&f_.right[i]), mask);
+    tot = _mm256_add_pd(tot, _mm256_cvtps_pd(_mm256_castps256_ps128(res)));
+    tot = _mm256_add_pd(tot, _mm256_cvtps_pd(_mm256_extractf128_ps(res, 1)));
+  }
+  return horizontal_add(tot);
+}
+
+// ROWS samples at once, each block of stumps (and its prefetches) done once for all of them.  a row's sum
+// is added up exactly as rf_sum_stumps_avx2 adds it
+template<size_t ROWS>
+static inline void rf_sum_stumps_tile(const stump_forest &f_, const float *x_, size_t stride_, double *out)
+{
+  __m256d tot[ROWS];
+  for(size_t r = 0 ; r < ROWS ; ++r) {
+    tot[r] = _mm256_setzero_pd();
+  }
+  const size_t pf = prefetch_distance() / sizeof(float);
+  for(size_t i = 0 ; i < f_.left.size() ; i += 8) {
+    if(pf) {
+      prefetch(&f_.splitVarID[i] + pf);
+      prefetch(&f_.splitValue[i] + pf);
+      prefetch(&f_.left[i] + pf);
+      prefetch(&f_.right[i] + pf);
+    }
+    __m256i id = _mm256_load_si256((const __m256i *)&f_.splitVarID[i]);
+    __m256 b = _mm256_load_ps(&f_.splitValue[i]);
+    __m256 left = _mm256_load_ps(&f_.left[i]);
+    __m256 right = _mm256_load_ps(&f_.right[i]);
+    for(size_t r = 0 ; r < ROWS ; ++r) {
+      __m256 a = _mm256_i32gather_ps(x_ + r * stride_, id, 4);
+      __m256 res = _mm256_blendv_ps(left, right, _mm256_cmp_ps(a, b, _CMP_NLE_UQ));
+      tot[r] = _mm256_add_pd(tot[r], _mm256_cvtps_pd(_mm256_castps256_ps128(res)));
+      tot[r] = _mm256_add_pd(tot[r], _mm256_cvtps_pd(_mm256_extractf128_ps(res, 1)));
+    }
+  }
+  for(size_t r = 0 ; r < ROWS ; ++r) {
+    out[r] = horizontal_add(tot[r]);
+  }
+}
+
+static void rf_sum_stumps_batch_avx2(const stump_forest &f_, const float *x_, size_t rows_, size_t stride_, double *out)
+{
+  size_t r = 0;
+  for( ; r + 4 <= rows_ ; r += 4) {
+    rf_sum_stumps_tile<4>(f_, x_ + r * stride_, stride_, out + r);
+  }
+  for( ; r < rows_ ; ++r) {
+    rf_sum_stumps_tile<1>(f_, x_ + r * stride_, stride_, out + r);
+  }
+}
+
+#endif
+
+double rf_sum_stumps(const stump_forest &f_, const float *x_)
+{
+  static const simd_isa isa = selected_isa();
+  switch(isa) {
+#if defined(__x86_64__)
+  case simd_isa::avx512:
+    return rf_sum_stumps_avx512(f_.splitVarID.data(), f_.splitValue.data(), f_.left.data(), f_.right.data(),
+				f_.left.size(), x_);
+  default:
+    return rf_sum_stumps_avx2(f_, x_);
+#elif defined(__aarch64__)
+  case simd_isa::sve:
+    return rf_sum_stumps_sve(f_.splitVarID.data(), f_.splitValue.data(), f_.left.data(), f_.right.data(),
+			     f_.left.size(), x_);
+  default:
+    return rf_sum_stumps_neon(f_.splitVarID.data(), f_.splitValue.data(), f_.left.data(), f_.right.data(),
+			      f_.left.size(), x_);
+#endif
+  }
+}
+
+void rf_eval_stumps_batch(const stump_forest &f_, const float *x_, size_t rows_, size_t num_preds_, double *out)
+{
+  static const simd_isa isa = selected_isa();
+  switch(isa) {
+#if defined(__x86_64__)
+  case simd_isa::avx512:
+    rf_sum_stumps_batch_avx512(f_.splitVarID.data(), f_.splitValue.data(), f_.left.data(), f_.right.data(),
+			       f_.left.size(), x_, rows_, num_preds_, out);
+    break;
+  default:
+    rf_sum_stumps_batch_avx2(f_, x_, rows_, num_preds_, out);
+    break;
+#else
+  default:
+    // no register tiled version here yet, score the rows one at a time
+    for(size_t r = 0 ; r < rows_ ; ++r) {
+      out[r] = rf_sum_stumps(f_, x_ + r * num_preds_);
+    }
+    break;
+#endif
+  }
+  for(size_t r = 0 ; r < rows_ ; ++r) {
+    out[r] /= f_.size;
+  }
+}
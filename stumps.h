@@ -0,0 +1,83 @@
+//
+// decision stump forest evaluation
+//
+// a forest of count stumps is stored as four parallel arrays:
+//
+// if(a[i] <= b[i]) {
+//   tot += x[i];
+// } else {
+//   tot += y[i];
+// }
+//
+// and every evaluator returns tot / count
+//
+// the simd versions take any count and any alignment: the bulk uses unaligned loads (which cost nothing
+// extra on aligned data) and the last partial register is read with masked loads, so nothing is read
+// past a + count etc
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "aligned.h"
+
+// the simd kernels keep one float sum per lane, whose rounding error grows with count (the last digits of
+// selectslow, selectf and selectf2 already differ).  with compensated sums on, selectf, selectf2 and
+// selectf_batch keep a kahan correction next to every lane and add the lanes up in double, which is exact
+// to about one float rounding whatever the count, for roughly twice the adds (and the 256-bit kernel even
+// on avx-512 cpus).  starts from SPEEDSTUMPS_COMPENSATED (1 = on, default off), read once per call
+bool compensated_sums();
+void set_compensated_sums(bool on_);
+
+// 256-bit simd implementation (or the 512-bit one on cpus with avx-512, see cpu.h)
+float selectf(const float *a, const float *b, const float *x, const float *y, size_t count);
+
+#if defined(__x86_64__)
+// the 256-bit version explicitly, whatever the cpu
+float selectf_avx2(const float *a, const float *b, const float *x, const float *y, size_t count);
+#endif
+
+// 128-bit simd implementation
+float selectf2(const float *a, const float *b, const float *x, const float *y, size_t count);
+
+// batched 256-bit simd implementation
+//
+// a holds rows_ samples, each one laid out like the single sample a above, with row r starting at
+// a + r * stride_ (stride_ is in floats, any value >= count)
+//
+// b, x and y are shared by every row and are streamed once per tile of rows instead of once per row,
+// out receives one result per row (identical to what selectf would return for that row)
+void selectf_batch(const float *a, size_t stride_, const float *b, const float *x, const float *y, size_t count,
+		   size_t rows_, float *out);
+
+// this is the traditional (slow) decision stump evaluation function
+float selectslow(const float *a, const float *b, const float *x, const float *y, size_t count);
+
+// a stump forest over a feature vector rather than pre-selected values, ie for stump i:
+//
+// a[i] = x_[splitVarID[i]], b[i] = splitValue[i], x[i] = left[i], y[i] = right[i]
+//
+// the arrays are padded to a multiple of 8 with stumps whose leaves are both 0
+struct stump_forest {
+  aligned_vector<uint32_t> splitVarID;
+  aligned_vector<float> splitValue;
+  aligned_vector<float> left, right;
+  size_t size = 0;     // number of real stumps
+
+  void push_back(uint32_t splitVarID_, float splitValue_, float left_, float right_);
+};
+
+// sum of the stump predictions for sample x_, this is selectf with a gather on the a side
+double rf_sum_stumps(const stump_forest &f_, const float *x_);
+
+inline double rf_eval_stumps(const stump_forest &f_, const float *x_)
+{
+  return rf_sum_stumps(f_, x_) / f_.size;
+}
+
+// rf_eval_stumps for rows_ row-major samples (num_preds_ predictors each), out receives exactly what
+// rf_eval_stumps returns for each row.  the rows are scored in register tiles, like selectf_batch, so the
+// stump arrays are streamed once per tile of rows rather than once per row
+void rf_eval_stumps_batch(const stump_forest &f_, const float *x_, size_t rows_, size_t num_preds_, double *out);
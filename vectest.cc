@@ -1,105 +1,25 @@
 //
 // a test program for decision stumps
 //
-// basic idea:
-//
-// 1) do a simd comparison of values to generate a mask
-// 2) use the mask to select values
-//
-// i.e. if we had some logic like:
-//
-// if(a[i] <= b[i]) {
-//   tot += x[i];
-// } else {
-//   tot += y[i];
-// }
-//
-// we could do this in parallel with simd instructions, and avoid branching entirely
-//
-// the instrinsics corresponding to the "basic idea" above are:
-// https://software.intel.com/sites/landingpage/IntrinsicsGuide/#techs=AVX&expand=486,518,848,848&text=_mm_cmp_ps
-//
-// and
-//
-// https://software.intel.com/sites/landingpage/IntrinsicsGuide/#techs=SSE4_1&expand=486,518&text=_mm_blendv_ps
-//
-// handy note:
-//
-// we can get an annotated dump like this:
-// objdump -d -M intel -S objs/opt/vectest.o  > vectest.asm
+// benchmarks the stump kernels in stumps.cc against each other (see stumps.cc for the basic idea)
 //
 
 #include <immintrin.h>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <random>
+#include <string>
+#include <vector>
 
-#include "util.h"
-
-inline float horizontal_add(__m256 &a) {
-  a = _mm256_hadd_ps(a,a);
-  a = _mm256_hadd_ps(a,a);
-  __m128 t1 = _mm256_extractf128_ps(a,1);
-  t1 = _mm_add_ss(_mm256_castps256_ps128(a),t1);
-  return _mm_cvtss_f32(t1);
-}
-
-inline float horizontal_add(__m128 &a) {
-  a = _mm_hadd_ps(a,a);
-  a = _mm_hadd_ps(a,a);
-  return _mm_cvtss_f32(a);
-}
-
-// 256-bit simd implementation
-float selectf(float *a, float *b, float *x, float *y, size_t count)
-{
-  __m256 *ap = (__m256*)a;
-  __m256 *bp = (__m256*)b;
-  __m256 *xp = (__m256*)x;
-  __m256 *yp = (__m256*)y;  
-  __m256 tot = _mm256_setzero_ps();
-
-  for(size_t i = 0 ; i < (count >> 3) ; ++i) {
-    __m256 mask = _mm256_cmp_ps(*ap++, *bp++, 30); // _CMP_GT_OQ aka > (ie the OPPOSITE of <= because we want an inverse result in the mask)
-    __m256 res = _mm256_blendv_ps(*xp++, *yp++, mask);
-    tot = _mm256_add_ps(tot, res); // vertically accumulate results
-  }
-  
-  return horizontal_add(tot) / count;
-}
-
-// 128-bit simd implementation
-float selectf2(float *a, float *b, float *x, float *y, size_t count)
-{
-  __m128 *ap = (__m128*)a;
-  __m128 *bp = (__m128*)b;
-  __m128 *xp = (__m128*)x;
-  __m128 *yp = (__m128*)y;  
-  __m128 tot = _mm_setzero_ps();
-
-  for(size_t i = 0 ; i < (count >> 2) ; ++i) {
-    __m128 mask = _mm_cmp_ps(*ap++, *bp++, 30); // _CMP_GT_OQ aka > (ie the OPPOSITE of <= because we want an inverse result in the mask)
-    __m128 res = _mm_blendv_ps(*xp++, *yp++, mask);
-    tot = _mm_add_ps(tot, res); // vertically accumulate results
-  }
-  
-  return horizontal_add(tot) / count;
-  
-}
-
-// this is the traditional (slow) decision stump evaluation function 
-float selectslow(float *a, float *b, float *x, float *y, size_t count)
-{
-  float total = 0.0;
-  for(size_t i = 0 ; i < count ; ++i) {
-    if(a[i] <= b[i]) {
-      total += x[i];
-    } else {
-      total += y[i];
-    }
-  }
-  return total / count;
-}
+#include "bench.h"
+#include "cpu.h"
+#include "half.h"
+#include "parallel.h"
+#include "quantize.h"
+#include "stream.h"
+#include "stumps.h"
 
 int main(int argc, char **argv)
 {
@@ -119,26 +39,126 @@ int main(int argc, char **argv)
     x[i] = _mm256_set_ps(d(g), d(g), d(g), d(g), d(g), d(g), d(g), d(g));
     y[i] = _mm256_set_ps(d(g), d(g), d(g), d(g), d(g), d(g), d(g), d(g));
   }
+
+  // the same shape with pre-binned a and b (random bins, so the values don't match selectf)
+  std::vector<int8_t> qa8(COUNT), qb8(COUNT);
+  std::vector<int16_t> qa16(COUNT), qb16(COUNT);
+  for(size_t i = 0 ; i < COUNT ; ++i) {
+    qa8[i] = g() % 128;
+    qb8[i] = g() % 128;
+    qa16[i] = g() % 32768;
+    qb16[i] = g() % 32768;
+  }
+
+  // a batch of samples sharing the same stumps (b, x, y)
+  const size_t ROWS = 16;
+  __m256 *batch = new __m256[ROWS*COUNT/8];
+  for(size_t i = 0 ; i < ROWS*COUNT/8 ; ++i) {
+    batch[i] = _mm256_set_ps(d(g), d(g), d(g), d(g), d(g), d(g), d(g), d(g));
+  }
+  std::vector<float> out(ROWS);
+
+  // the same stumps as a stump_forest over a feature vector, evaluated on every cpu we can use
+  const size_t NUM_PREDS = 256;
+  stump_forest sf;
+  for(size_t i = 0 ; i < COUNT ; ++i) {
+    sf.push_back(g() % NUM_PREDS, b[i/8][i%8], x[i/8][i%8], y[i/8][i%8]);
+  }
+  std::vector<float> preds(NUM_PREDS);
+  for(size_t i = 0 ; i < NUM_PREDS ; ++i) {
+    preds[i] = d(g);
+  }
+  auto sharded = shard_stumps(sf);
+  stump_forest_half sf16(sf, half_format::fp16), sfbf16(sf, half_format::bf16);
     
-  std::cout << "Running tests on " << COUNT << " elements" << std::endl;
-
-  auto timer = []<typename FUNC>(FUNC f_, size_t trials_, const std::string &name_) {
-    int64_t start,end;
-    double total = 0.0;
-    double val = 0.0;
-    for(size_t trial = 0 ; trial < trials_ ; ++trial) {
-      start = get_ts();
-      val = f_();
-      end = get_ts();
-      total += (end - start);
-    }
-    total /= trials_;
-    std::cout << (uint64_t)total << " nanos/trial (" << trials_ << " trials) for " << name_ << " (val=" << val << ")" << std::endl;
-  };
+  std::cout << "Running tests on " << COUNT << " elements (" << isa_name(selected_isa()) << " kernels)" << std::endl;
 
   timer([&](){ return selectslow(&a[0][0],&b[0][0],&x[0][0],&y[0][0],COUNT); }, TRIALS, "selectslow");
   timer([&](){ return selectf(&a[0][0],&b[0][0],&x[0][0],&y[0][0],COUNT); }, TRIALS, "selectf");
   timer([&](){ return selectf2(&a[0][0],&b[0][0],&x[0][0],&y[0][0],COUNT); }, TRIALS, "selectf2");
 
+  timer([&](){ return selectq(&qa8[0],&qb8[0],&x[0][0],&y[0][0],COUNT); }, TRIALS, "selectq int8");
+  timer([&](){ return selectq(&qa16[0],&qb16[0],&x[0][0],&y[0][0],COUNT); }, TRIALS, "selectq int16");
+
+  // misaligned by one float and a count that leaves a partial register, should match selectslow
+  timer([&](){ return selectslow(&a[0][1],&b[0][1],&x[0][1],&y[0][1],COUNT-5); }, TRIALS, "selectslow (unaligned)");
+  timer([&](){ return selectf(&a[0][1],&b[0][1],&x[0][1],&y[0][1],COUNT-5); }, TRIALS, "selectf (unaligned)");
+  timer([&](){ return selectf2(&a[0][1],&b[0][1],&x[0][1],&y[0][1],COUNT-5); }, TRIALS, "selectf2 (unaligned)");
+
+  // batch results are reported as the mean over the rows
+  timer([&](){
+    double tot = 0.0;
+    for(size_t r = 0 ; r < ROWS ; ++r) {
+      tot += selectf(&batch[r*COUNT/8][0],&b[0][0],&x[0][0],&y[0][0],COUNT);
+    }
+    return tot / ROWS;
+  }, TRIALS/10, "selectf x" + std::to_string(ROWS) + " rows");
+  timer([&](){
+    selectf_batch(&batch[0][0],COUNT,&b[0][0],&x[0][0],&y[0][0],COUNT,ROWS,&out[0]);
+    double tot = 0.0;
+    for(size_t r = 0 ; r < ROWS ; ++r) {
+      tot += out[r];
+    }
+    return tot / ROWS;
+  }, TRIALS/10, "selectf_batch " + std::to_string(ROWS) + " rows");
+
+  timer([&](){ return rf_eval_stumps(sf, &preds[0]); }, TRIALS, "rf_eval_stumps");
+  timer([&](){ return rf_eval_parallel(sharded, &preds[0]); }, TRIALS,
+	"rf_eval_parallel (" + std::to_string(sharded.shards.size()) + " threads)");
+  timer([&](){ return rf_eval_stumps_half(sf16, &preds[0]); }, TRIALS, "rf_eval_stumps_half fp16");
+  timer([&](){ return rf_eval_stumps_half(sfbf16, &preds[0]); }, TRIALS, "rf_eval_stumps_half bf16");
+
+  // how far the 16-bit stumps are from the fp32 ones, over a few feature vectors
+  const size_t SAMPLES = 16;
+  for(const auto *h : {&sf16, &sfbf16}) {
+    double max_abs = 0.0, max_val = 0.0;
+    std::mt19937_64 gs(4321);
+    std::vector<float> s(NUM_PREDS);
+    for(size_t k = 0 ; k < SAMPLES ; ++k) {
+      for(auto &v : s) {
+	v = d(gs);
+      }
+      double want = rf_eval_stumps(sf, &s[0]);
+      double err = std::abs(rf_eval_stumps_half(*h, &s[0]) - want);
+      max_abs = std::max(max_abs, err);
+      max_val = std::max(max_val, std::abs(want));
+    }
+    std::cout << half_format_name(h->format) << " vs fp32 over " << SAMPLES << " samples: max abs err " << max_abs
+	      << " (fp32 results up to " << max_val << ")" << std::endl;
+  }
+
+  // the stumps streamed from columns, every third value of predictor 0 null (which has to score as NaN)
+  {
+    std::mt19937_64 gs(4321);
+    std::vector<float> cols(NUM_PREDS * SAMPLES);
+    for(auto &v : cols) {
+      v = d(gs);
+    }
+    std::vector<uint8_t> valid((SAMPLES + 7) / 8, 0);
+    for(size_t r = 0 ; r < SAMPLES ; ++r) {
+      valid[r / 8] |= (r % 3 != 0) << (r % 8);
+    }
+    column_source src;
+    src.rows = SAMPLES;
+    for(size_t j = 0 ; j < NUM_PREDS ; ++j) {
+      src.columns.push_back({ &cols[j * SAMPLES], j == 0 ? &valid[0] : nullptr });
+    }
+    std::vector<double> streamed(SAMPLES);
+    rf_eval_stream(sf, src, &streamed[0], 5);
+
+    size_t mismatches = 0;
+    std::vector<float> s(NUM_PREDS);
+    for(size_t r = 0 ; r < SAMPLES ; ++r) {
+      for(size_t j = 0 ; j < NUM_PREDS ; ++j) {
+	s[j] = cols[j * SAMPLES + r];
+      }
+      if(r % 3 == 0) {
+	s[0] = NAN;
+      }
+      mismatches += streamed[r] != rf_eval_stumps(sf, &s[0]);
+    }
+    std::cout << "rf_eval_stream vs rf_eval_stumps over " << SAMPLES << " samples (with nulls): " << mismatches << " mismatches" << std::endl;
+  }
+
   return 0;
 }
@@ -1,168 +1,40 @@
 //
 // a test program for 2-level decision trees
 //
-// the idea is based on what vectest.cc does.  in this case it is a little more complex because things are 2-level
-//
-// similar to gpu programming we can imagine branches being "shut off" if they are not selected
-//
-// imagine we do a _mm256_cmp_ps, this gives us 8 floating point lanes
-// there are 4 possible outcomes from a 2-level decision tree
-// lets say the tree looks like this:
-/*
-         a <= b
-        /      \
-      c <= d  e <= f
-       /  \    /  \
-      1    2  3    4
-*/
-//
-// if we stack the comparisons vertically, we could do the following:
-//
-// aabb
-//  <=
-// bbaa
-//  && 
-// cdef
-//  <=
-// dcfe
-//
-// So, we have two sets of comparisons that generate masks, and at the end
-// we take the bitwise && of the two masks -- only one possibility will be 1.
-//
-// Since we have 8 lanes and only use 4, this means we can evaluate two trees at once.
-//
-// This implies we should store the trees differently than the way they are usually stored.
-// It would be best to store a,b,c,d and 1,2,3,4 all in the same structure.
+// benchmarks the traditional forest evaluation against the simd version (see forest.h for the idea)
 //
 
-#include <immintrin.h>
-
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <cmath>
+#include <filesystem>
 #include <iostream>
 #include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
-#include "util.h"
-
-inline float horizontal_add(__m256 &a) {
-  a = _mm256_hadd_ps(a,a);
-  a = _mm256_hadd_ps(a,a);
-  __m128 t1 = _mm256_extractf128_ps(a,1);
-  t1 = _mm_add_ss(_mm256_castps256_ps128(a),t1);
-  return _mm_cvtss_f32(t1);
-}
-
-struct node
-{
-  uint64_t leftChildNodeID;
-  uint64_t rightChildNodeID;
-  uint64_t splitVarID;
-  float splitValue;              
-};
+#include "bench.h"
+#include "aligned.h"
+#include "anytime.h"
+#include "compile.h"
+#include "conditions.h"
+#include "cpu.h"
+#include "flat_forest.h"
+#include "forest.h"
+#include "forest_file.h"
+#include "forest_soa.h"
+#include "half.h"
+#include "model_handle.h"
+#include "multi_output.h"
+#include "parallel.h"
+#include "quantize.h"
+#include "reorder.h"
+#include "stream.h"
 
-typedef std::vector<node> tree;
 std::vector<tree> forest;
-
-double tree_eval(const tree &t_, const std::vector<float> &x_)
-{
-  // For each sample start in root, drop down the tree and return final value
-  size_t nodeID = 0;
-  while (1) {
-    const auto &tn = t_[nodeID];
-    // Break if terminal node
-    if (tn.leftChildNodeID == 0 && tn.rightChildNodeID == 0) {
-      break;
-    }
-
-    // Move to child
-    double value = x_[tn.splitVarID];
-
-    if (value <= tn.splitValue) {
-      // Move to left child
-      nodeID = tn.leftChildNodeID;
-    } else {
-      // Move to right child
-      nodeID = tn.rightChildNodeID;
-    }
-  }
-
-  return t_[nodeID].splitValue;
-}
-
-double rf_eval(const std::vector<tree> &f_, const std::vector<float> &x_)
-{
-  double total = 0.0;
-  for(const auto &t : f_) {
-    total += tree_eval(t, x_);
-  }
-  return total / f_.size();
-}
-
-// pack entire tree into structure for the SIMD version
-struct tree2 {
-  uint32_t a_splitVarID, c_splitVarID, e_splitVarID;
-  float b_splitValue, d_splitValue, f_splitValue;
-  float one, two, three, four;
-};
-
-std::vector<tree2> forest2;
-
-inline double tree_eval_simd(const tree2 &t1_, const tree2 &t2_, const std::vector<float> &x_)
-{
-  __m256 cmp1 = _mm256_set_ps(x_[t1_.a_splitVarID],
-			      x_[t1_.a_splitVarID],
-			      t1_.b_splitValue,
-			      t1_.b_splitValue,
-			      x_[t2_.a_splitVarID],
-			      x_[t2_.a_splitVarID],
-			      t2_.b_splitValue,
-			      t2_.b_splitValue);
-  // note we could probably achieve this with a shuffle
-  __m256 cmp2 = _mm256_set_ps(t1_.b_splitValue,
-			      t1_.b_splitValue,
-			      x_[t1_.a_splitVarID],
-			      x_[t1_.a_splitVarID],
-			      t2_.b_splitValue,
-			      t2_.b_splitValue,
-			      x_[t2_.a_splitVarID],
-			      x_[t2_.a_splitVarID]);
-  __m256 cmpres1 = _mm256_cmp_ps(cmp1, cmp2, 18); // <= 
-
-  cmp1 = _mm256_set_ps(x_[t1_.c_splitVarID],
-		       t1_.d_splitValue,		      
-		       x_[t1_.e_splitVarID],
-		       t1_.f_splitValue,
-		       x_[t2_.c_splitVarID],
-		       t2_.d_splitValue,		       
-		       x_[t2_.e_splitVarID],
-		       t2_.f_splitValue);
-  cmp2 = _mm256_set_ps(t1_.d_splitValue,
-		       x_[t1_.c_splitVarID],		       
-		       t1_.f_splitValue,
-		       x_[t1_.e_splitVarID],
-		       t2_.d_splitValue,
-		       x_[t2_.c_splitVarID],		       
-		       t2_.f_splitValue,
-		       x_[t2_.e_splitVarID]);
-
-  __m256 cmpres2 = _mm256_cmp_ps(cmp1, cmp2, 18); // <=
-
-  __m256i mask = _mm256_and_si256((__m256i)cmpres1, (__m256i)cmpres2);
-  __m256 res1 = _mm256_set_ps(t1_.one, t1_.two, t1_.three, t1_.four,
-			     t2_.one, t2_.two, t2_.three, t2_.four);
-  __m256 res2 = _mm256_setzero_ps();
-  _mm256_maskstore_ps((float *)(&res2), mask, res1);
-  
-  return horizontal_add(res2); // note: the SUM of the two trees!
-}
-
-double rf_eval_simd(const std::vector<tree2> &f_, const std::vector<float> &x_)
-{
-  double total = 0.0;
-  size_t count = f_.size() / 2;
-  for(size_t i = 0 ; i < count ; i++) {
-    total += tree_eval_simd(f_[i*2 + 0], f_[i*2 + 1], x_);
-  }
-  return total / f_.size();;
-}
+forest2 f2;
 
 int main(int argc, char **argv)
 {
@@ -192,37 +64,305 @@ int main(int argc, char **argv)
     x[i] = d(g);
   }
 
+  // a batch of samples, stored both ways
+  const size_t ROWS = 32;
+  std::vector<std::vector<float>> rows(ROWS, std::vector<float>(NUM_PREDS));
+  std::vector<float> xrow(ROWS * NUM_PREDS), xcol(ROWS * NUM_PREDS);
+  for(size_t r = 0 ; r < ROWS ; ++r) {
+    for(size_t i = 0 ; i < NUM_PREDS ; ++i) {
+      rows[r][i] = xrow[r * NUM_PREDS + i] = xcol[i * ROWS + r] = d(g);
+    }
+  }
+  std::vector<double> out(ROWS);
+
   // now, restructure the tree so we can evaluate it with SIMD
-  // build a forest with trees of depth 2
-  for(size_t t = 0 ; t < NUM_TREES ; ++t) {
-    const auto &treep = forest[t];
+  f2 = compile_forest2(forest, NUM_PREDS);
+
+  // and again as structure-of-arrays
+  forest2_soa soa(f2);
+
+  // and as one flat arena for the scalar path
+  flat_forest flat(forest);
+
+  // and sorted by split feature
+  forest2 sorted2 = reorder_forest2(f2);
+  forest2_soa sorted_soa(sorted2);
 
-    tree2 tt = { treep[0].splitVarID, treep[1].splitVarID, treep[2].splitVarID,
-		treep[0].splitValue, treep[1].splitValue, treep[2].splitValue,
-		treep[3].splitValue, treep[4].splitValue, treep[5].splitValue, treep[6].splitValue };
+  // and with 16-bit thresholds and leaves
+  forest2_soa_half soa16(soa, half_format::fp16), soabf16(soa, half_format::bf16);
 
-    forest2.push_back(tt);
+  // and with the thresholds as bin indices, rows are binned when they're scored
+  feature_bins bins(soa, NUM_PREDS);
+  quantized_soa qsoa(soa, bins);
+  std::vector<int16_t> qx(NUM_PREDS + 1);
+
+  // and as shared conditions evaluated once per row
+  condition_forest conds(soa, NUM_PREDS), sorted_conds(sorted_soa, NUM_PREDS);
+  aligned_vector<uint32_t> cbits(conds.words());
+
+  // and with K-wide leaves, against K scalar forests with the same splits (one per output)
+  const size_t OUTPUTS = 10;
+  multi_forest2 multi(OUTPUTS);
+  std::vector<forest2_soa> per_output(OUTPUTS);
+  std::vector<float> leaf_vectors(4 * OUTPUTS);
+  for(const auto &t : f2) {
+    for(auto &v : leaf_vectors) {
+      v = d(g);
+    }
+    multi.push_back(t, &leaf_vectors[0]);
+    for(size_t k = 0 ; k < OUTPUTS ; ++k) {
+      tree2 tk = t;
+      tk.one = leaf_vectors[0 * OUTPUTS + k];
+      tk.two = leaf_vectors[1 * OUTPUTS + k];
+      tk.three = leaf_vectors[2 * OUTPUTS + k];
+      tk.four = leaf_vectors[3 * OUTPUTS + k];
+      per_output[k].push_back(tk);
+    }
+  }
+  std::vector<double> multi_out(OUTPUTS);
+
+  // and weighted, boosting style (later trees matter less), for anytime scoring
+  std::vector<float> weights(NUM_TREES);
+  for(size_t t = 0 ; t < NUM_TREES ; ++t) {
+    weights[t] = std::exp(-(double)t / 20000);
   }
+  anytime_forest anytime(f2, weights);
+
+  // and split across every cpu we can use
+  auto sharded = shard_forest2(f2);
   
-  std::cout << "Running " << TRIALS << " trials on forest with " << NUM_TREES << " trees of depth=2" << std::endl;
-
-  auto timer = []<typename FUNC>(FUNC f_, size_t trials_, const std::string &name_) {
-    int64_t start,end;
-    double total = 0.0;
-    double val = 0.0;
-    for(size_t trial = 0 ; trial < trials_ ; ++trial) {
-      start = get_ts();
-      val = f_();
-      end = get_ts();
-      total += (end - start);
+  std::cout << "Running " << TRIALS << " trials on forest with " << NUM_TREES << " trees of depth=2 (" << isa_name(selected_isa()) << " kernels, "
+	    << page_mode_name(selected_page_mode()) << " pages)" << std::endl;
+
+  timer([&](){ return rf_eval(forest, x); }, TRIALS, "rf_eval");
+
+  timer([&](){ return rf_eval_flat(flat, &x[0]); }, TRIALS, "rf_eval_flat");
+
+  // what building and freeing a model costs, one allocation per tree against one for the arena
+  timer([&](){ std::vector<tree> copy(forest); return (double)copy.size(); }, 5, "copy of the vector<tree> (build + free)");
+  timer([&](){ flat_forest copy(forest); return (double)copy.size(); }, 5, "flat_forest (validate + build + free)");
+
+  timer([&](){ return rf_eval_simd(f2, x); }, TRIALS, "rf_eval_simd");
+
+  timer([&](){ return rf_eval_simd_gather(f2, x); }, TRIALS, "rf_eval_simd_gather");
+
+  timer([&](){ return rf_eval_soa(soa, x); }, TRIALS, "rf_eval_soa");
+
+  // sweep the software prefetch distance, 0 leaves it to the hardware prefetcher
+  const size_t saved_prefetch = prefetch_distance();
+  for(size_t bytes : {0, 256, 512, 1024, 2048}) {
+    set_prefetch_distance(bytes);
+    timer([&](){ return rf_eval_simd_gather(f2, x); }, TRIALS, "rf_eval_simd_gather (prefetch " + std::to_string(bytes) + ")");
+    timer([&](){ return rf_eval_soa(soa, x); }, TRIALS, "rf_eval_soa (prefetch " + std::to_string(bytes) + ")");
+  }
+  set_prefetch_distance(saved_prefetch);
+
+  timer([&](){ return rf_eval_simd_gather(sorted2, x); }, TRIALS, "rf_eval_simd_gather (sorted by feature)");
+
+  timer([&](){ return rf_eval_soa(sorted_soa, x); }, TRIALS, "rf_eval_soa (sorted by feature)");
+
+  timer([&](){ return rf_eval_soa_half(soa16, &x[0]); }, TRIALS, "rf_eval_soa_half fp16");
+
+  timer([&](){ return rf_eval_soa_half(soabf16, &x[0]); }, TRIALS, "rf_eval_soa_half bf16");
+
+  timer([&](){ bins.quantize(&x[0], &qx[0]); return rf_eval_quantized(qsoa, &qx[0]); }, TRIALS,
+	"rf_eval_quantized (" + std::to_string(bins.max_cuts()) + " max bins)");
+
+  timer([&](){ conds.evaluate(&x[0], &cbits[0]); return rf_eval_conditions(conds, &cbits[0]); }, TRIALS,
+	"rf_eval_conditions (" + std::to_string(conds.conditions()) + " conditions)");
+
+  timer([&](){ sorted_conds.evaluate(&x[0], &cbits[0]); return rf_eval_conditions(sorted_conds, &cbits[0]); }, TRIALS,
+	"rf_eval_conditions (sorted by feature)");
+
+  timer([&](){ rf_eval_multi(multi, &x[0], &multi_out[0]); return multi_out[0]; }, TRIALS,
+	"rf_eval_multi " + std::to_string(OUTPUTS) + " outputs");
+
+  timer([&](){
+    for(size_t k = 0 ; k < OUTPUTS ; ++k) {
+      multi_out[k] = rf_eval_soa(per_output[k], x);
+    }
+    return multi_out[0];
+  }, TRIALS, "rf_eval_soa x" + std::to_string(OUTPUTS) + " outputs");
+
+  timer([&](){ return rf_eval_parallel(sharded, &x[0]); }, TRIALS,
+	"rf_eval_parallel (" + std::to_string(sharded.shards.size()) + " threads)");
+
+  // batch results are reported as the mean over the rows
+  auto mean = [&]() {
+    double tot = 0.0;
+    for(size_t r = 0 ; r < ROWS ; ++r) {
+      tot += out[r];
     }
-    total /= trials_;
-    std::cout << (uint64_t)total << " nanos/trial (" << trials_ << " trials) for " << name_ << " (val=" << val << ")" << std::endl;
+    return tot / ROWS;
   };
+  const std::string batch = std::to_string(ROWS) + " rows";
 
-  timer([&](){ return rf_eval(forest, x); }, TRIALS, "rf_eval");
+  timer([&](){
+    for(size_t r = 0 ; r < ROWS ; ++r) {
+      out[r] = rf_eval_simd(f2, rows[r]);
+    }
+    return mean();
+  }, TRIALS/20, "rf_eval_simd x" + batch);
+  timer([&](){ rf_eval_simd_batch(f2, &xrow[0], ROWS, NUM_PREDS, sample_layout::row_major, &out[0]); return mean(); },
+	TRIALS/20, "rf_eval_simd_batch row_major " + batch);
+  timer([&](){ rf_eval_parallel_batch(soa, &xrow[0], ROWS, NUM_PREDS, &out[0]); return mean(); },
+	TRIALS/20, "rf_eval_parallel_batch (" + std::to_string(default_pool().size()) + " threads) " + batch);
+  timer([&](){ rf_eval_simd_batch(f2, &xcol[0], ROWS, NUM_PREDS, sample_layout::col_major, &out[0]); return mean(); },
+	TRIALS/20, "rf_eval_simd_batch col_major " + batch);
+
+  // the same columns streamed out of a mapped matrix file, in blocks of 8 rows so the staging overlaps
+  const std::string matrix_path = (std::filesystem::temp_directory_path() / "vectest2.matrix").string();
+  save_feature_matrix(&xcol[0], ROWS, NUM_PREDS, matrix_path);
+  {
+    mapped_feature_matrix matrix(matrix_path, NUM_PREDS);
+    std::vector<double> streamed(ROWS);
+    timer([&](){ rf_eval_stream(f2, matrix.columns(), &streamed[0], 8); return streamed[0]; },
+	  TRIALS/20, "rf_eval_stream (rf_eval_simd_batch, mapped) " + batch);
+    rf_eval_simd_batch(f2, &xcol[0], ROWS, NUM_PREDS, sample_layout::col_major, &out[0]);
+    size_t mismatches = 0;
+    for(size_t r = 0 ; r < ROWS ; ++r) {
+      mismatches += streamed[r] != out[r];
+    }
+    timer([&](){ rf_eval_stream(soa, matrix.columns(), &streamed[0], 8); return streamed[0]; },
+	  TRIALS/20, "rf_eval_stream (rf_eval_parallel_batch, mapped) " + batch);
+    for(size_t r = 0 ; r < ROWS ; ++r) {
+      mismatches += streamed[r] != rf_eval_soa(soa, rows[r]);
+    }
+    std::cout << "rf_eval_stream vs the in-memory kernels over " << ROWS << " rows: " << mismatches << " mismatches" << std::endl;
+  }
+  std::filesystem::remove(matrix_path);
 
-  timer([&](){ return rf_eval_simd(forest2, x); }, TRIALS, "rf_eval_simd");
+  // how far the 16-bit forests are from rf_eval, over the batch rows
+  for(const auto *h : {&soa16, &soabf16}) {
+    double max_abs = 0.0, max_val = 0.0;
+    for(size_t r = 0 ; r < ROWS ; ++r) {
+      double want = rf_eval(forest, rows[r]);
+      double err = std::abs(rf_eval_soa_half(*h, &rows[r][0]) - want);
+      max_abs = std::max(max_abs, err);
+      max_val = std::max(max_val, std::abs(want));
+    }
+    std::cout << half_format_name(h->format) << " vs rf_eval over " << ROWS << " rows: max abs err " << max_abs
+	      << " (fp32 results up to " << max_val << ")" << std::endl;
+  }
+
+  // the multi-output sums group trees differently from rf_eval_soa
+  double max_multi = 0.0;
+  for(size_t r = 0 ; r < ROWS ; ++r) {
+    rf_eval_multi(multi, &rows[r][0], &multi_out[0]);
+    for(size_t k = 0 ; k < OUTPUTS ; ++k) {
+      max_multi = std::max(max_multi, std::abs(multi_out[k] - rf_eval_soa(per_output[k], rows[r])));
+    }
+  }
+  std::cout << "rf_eval_multi vs rf_eval_soa per output over " << ROWS << " rows: max abs diff " << max_multi << std::endl;
+
+  // anytime scoring: the weighted sum in full, and stopping early on a budget or once the sign is settled
+  timer([&](){ return rf_sum_weighted(anytime, &x[0]); }, TRIALS, "rf_sum_weighted");
+  timer([&](){ anytime_budget b; b.max_trees = 50000; return rf_score_anytime(anytime, &x[0], b).margin; }, TRIALS,
+	"rf_score_anytime (50000 trees)");
+  timer([&](){
+    anytime_budget b;
+    b.deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(100);
+    return rf_score_anytime(anytime, &x[0], b).margin;
+  }, TRIALS, "rf_score_anytime (100us)");
+  size_t decided_trees = 0, wrong_side = 0;
+  timer([&](){
+    anytime_budget b;
+    b.threshold = 0.0;
+    decided_trees = wrong_side = 0;
+    for(size_t r = 0 ; r < ROWS ; ++r) {
+      anytime_result res = rf_score_anytime(anytime, &rows[r][0], b);
+      decided_trees += res.trees;
+      wrong_side += (res.margin > 0) != (rf_sum_weighted(anytime, &rows[r][0]) > 0);
+    }
+    return (double)decided_trees / ROWS;
+  }, 1, "rf_score_anytime (sign of the margin) x" + batch + ", plus the full scores to check");
+  std::cout << "sign settled after " << decided_trees / ROWS << " trees on average, " << wrong_side << " rows on the wrong side" << std::endl;
+
+  // reordering only changes the rounding of the sums
+  // (rf_eval_simd adds pairs of trees in float first, the soa kernel adds every tree in double)
+  double max_diff = 0.0, max_diff_soa = 0.0;
+  for(size_t r = 0 ; r < ROWS ; ++r) {
+    max_diff = std::max(max_diff, std::abs(rf_eval_simd(sorted2, rows[r]) - rf_eval_simd(f2, rows[r])));
+    max_diff_soa = std::max(max_diff_soa, std::abs(rf_eval_soa(sorted_soa, rows[r]) - rf_eval_soa(soa, rows[r])));
+  }
+  std::cout << "sorted vs original over " << ROWS << " rows: max abs diff " << max_diff << " (rf_eval_simd), "
+	    << max_diff_soa << " (rf_eval_soa)" << std::endl;
+
+  // the flat walk adds the same leaves in the same order
+  size_t mismatches = 0;
+  for(size_t r = 0 ; r < ROWS ; ++r) {
+    mismatches += rf_eval_flat(flat, &rows[r][0]) != rf_eval(forest, rows[r]);
+  }
+  std::cout << "rf_eval_flat vs rf_eval over " << ROWS << " rows: " << mismatches << " mismatches" << std::endl;
+
+  // binning is exact, so the quantized forest should make the same decisions as the float one
+  mismatches = 0;
+  for(size_t r = 0 ; r < ROWS ; ++r) {
+    bins.quantize(&rows[r][0], &qx[0]);
+    mismatches += rf_sum_quantized(qsoa, &qx[0]) != rf_sum_soa(soa.view(), &rows[r][0]);
+  }
+  std::cout << "quantized vs rf_eval_soa over " << ROWS << " rows: " << mismatches << " mismatches" << std::endl;
+
+  // and so are the condition bits
+  mismatches = 0;
+  for(size_t r = 0 ; r < ROWS ; ++r) {
+    conds.evaluate(&rows[r][0], &cbits[0]);
+    mismatches += rf_sum_conditions(conds, &cbits[0]) != rf_sum_soa(soa.view(), &rows[r][0]);
+  }
+  std::cout << "conditions vs rf_eval_soa over " << ROWS << " rows: " << mismatches << " mismatches" << std::endl;
+
+  // the soa forest through a file: load time is just the mmap and header check, scoring faults the pages in
+  const std::string path = (std::filesystem::temp_directory_path() / "vectest2.forest").string();
+  save_forest2_soa(soa, path, NUM_PREDS);
+  timer([&](){ mapped_forest2_soa m(path); return (double)m.view().size; }, TRIALS, "mapped_forest2_soa open");
+  {
+    mapped_forest2_soa mapped(path);
+    timer([&](){ return rf_eval_soa(mapped.view(), &x[0]); }, TRIALS, "rf_eval_soa (mapped)");
+  }
+
+  // and hot swapped: readers keep scoring through the handle while new mappings are published under them
+  model_handle<mapped_forest2_soa> handle(std::make_unique<mapped_forest2_soa>(path));
+  timer([&](){ return handle.with([&](const mapped_forest2_soa &m_) { return rf_eval_soa(m_.view(), &x[0]); }); },
+	TRIALS, "rf_eval_soa (model_handle)");
+
+  const size_t READERS = 2, SWAPS = 20;
+  const double want = rf_eval_soa(soa, x);
+  std::atomic<bool> done(false);
+  std::atomic<size_t> evals(0), wrong(0);
+  std::vector<std::thread> readers;
+  for(size_t t = 0 ; t < READERS ; ++t) {
+    readers.emplace_back([&]() {
+      while(!done) {
+	auto m = handle.acquire();
+	wrong += rf_eval_soa(m->view(), &x[0]) != want;
+	++evals;
+      }
+    });
+  }
+  for(size_t s = 0 ; s < SWAPS ; ++s) {
+    handle.publish_async([&]() { return std::make_unique<mapped_forest2_soa>(path); }).get();
+  }
+  done = true;
+  for(auto &r : readers) {
+    r.join();
+  }
+  std::cout << evals << " evaluations by " << READERS << " readers across " << SWAPS << " swaps (now version "
+	    << handle.version() << "): " << wrong << " wrong" << std::endl;
+
+  // a file whose splits don't fit the predictors it claims is refused at load
+  save_forest2_soa(soa, path, 1);
+  bool refused = false;
+  try {
+    mapped_forest2_soa m(path);
+  } catch(const std::runtime_error &e) {
+    std::cout << "refused: " << e.what() << std::endl;
+    refused = true;
+  }
+  std::filesystem::remove(path);
+  if(!refused) {
+    std::cout << "a forest file with out of range split ids loaded" << std::endl;
+    return 1;
+  }
   
   return 0;
 }
@@ -0,0 +1,118 @@
+//
+// a test program for deeper (complete) decision trees
+//
+// benchmarks the traditional forest evaluation against simd_forest<Depth> (see simd_forest.h for the idea)
+//
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "compile.h"
+#include "engine.h"
+#include "forest.h"
+#include "quickscorer.h"
+#include "simd_forest.h"
+
+const size_t NUM_PREDS = 256; // we'll consider 256 possible predictors
+
+// append a random subtree to t_ at nodeID_, splitting with probability split_ down to max_depth_
+// children are numbered in the order they are created, like ranger does
+template<typename G>
+void random_subtree(G &g_, tree &t_, size_t nodeID_, size_t max_depth_, double split_)
+{
+  std::uniform_real_distribution<float> d(-0.1, 0.1);
+  std::bernoulli_distribution b(split_);
+  if(max_depth_ == 0 || !b(g_)) {
+    t_[nodeID_] = {0, 0, 0, d(g_) }; // terminal node
+    return;
+  }
+  size_t left = t_.size(), right = t_.size() + 1;
+  t_[nodeID_] = {left, right, g_() % NUM_PREDS, d(g_) };
+  t_.resize(t_.size() + 2);
+  random_subtree(g_, t_, left, max_depth_ - 1, split_);
+  random_subtree(g_, t_, right, max_depth_ - 1, split_);
+}
+
+// simd_forest<Depth> for the depths it covers, quickscorer_forest for depth >= 4
+template<size_t Depth>
+void run(size_t num_trees_, size_t trials_, double split_ = 1.0)
+{
+  std::mt19937_64 g(1234);      // mersenne twister with constant seed for reproducibility
+  std::uniform_real_distribution<float> d(-0.1, 0.1);
+
+  // build a forest of trees of depth <= Depth (complete ones when split_ is 1)
+  std::vector<tree> forest;
+  for(size_t t = 0 ; t < num_trees_ ; ++t) {
+    tree treep(1);
+    random_subtree(g, treep, 0, Depth, split_);
+    forest.push_back(treep);
+  }
+
+  // generate predictors
+  std::vector<float> x(NUM_PREDS);
+  for(size_t i = 0 ; i < NUM_PREDS ; ++i) {
+    x[i] = d(g);
+  }
+
+  std::cout << "Running " << trials_ << " trials on forest with " << num_trees_ << " trees of depth" << (split_ < 1.0 ? "<=" : "=") << Depth << std::endl;
+
+  timer([&](){ return rf_eval(forest, x); }, trials_, "rf_eval");
+
+  if constexpr (Depth <= ENGINE_MAX_PACKED_DEPTH) {
+    simd_forest<Depth> forestp = compile_forest<Depth>(forest, NUM_PREDS);
+    timer([&](){ return rf_eval_simd(forestp, x); }, trials_, "simd_forest<" + std::to_string(Depth) + ">");
+  }
+
+  if constexpr (Depth >= 4) {
+    quickscorer_forest qs(forest, NUM_PREDS);
+    timer([&](){ return rf_eval_quickscorer(qs, x); }, trials_, "rf_eval_quickscorer");
+  }
+}
+
+// forests mixing every depth from lone leaves to max_depth_, through the bucketed engine
+void run_mixed(size_t num_trees_, size_t max_depth_, size_t trials_)
+{
+  std::mt19937_64 g(1234);      // mersenne twister with constant seed for reproducibility
+  std::uniform_real_distribution<float> d(-0.1, 0.1);
+
+  std::vector<tree> forest;
+  for(size_t t = 0 ; t < num_trees_ ; ++t) {
+    tree treep(1);
+    random_subtree(g, treep, 0, t % (max_depth_ + 1), 0.9);
+    forest.push_back(treep);
+  }
+  forest_engine engine(forest, NUM_PREDS);
+
+  std::vector<float> x(NUM_PREDS);
+  for(size_t i = 0 ; i < NUM_PREDS ; ++i) {
+    x[i] = d(g);
+  }
+
+  std::cout << "Running " << trials_ << " trials on forest with " << num_trees_ << " trees of mixed depth<=" << max_depth_ << std::endl;
+
+  timer([&](){ return rf_eval(forest, x); }, trials_, "rf_eval");
+
+  timer([&](){ return rf_eval_engine(engine, x); }, trials_, "rf_eval_engine");
+}
+
+int main(int argc, char **argv)
+{
+  const size_t TRIALS = 100;
+
+  run<3>(100000, TRIALS);
+  run<4>(100000, TRIALS);
+  run<6>(25000, TRIALS);
+  run<8>(10000, TRIALS);
+
+  // unbalanced trees, padded out to complete depth by compile_forest
+  run<4>(100000, TRIALS, 0.7);
+  run<8>(100000, TRIALS, 0.7);
+
+  // a bit of everything
+  run_mixed(100000, 9, TRIALS);
+
+  return 0;
+}